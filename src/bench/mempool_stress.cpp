@@ -0,0 +1,122 @@
+// Copyright (c) 2011-2019 The Bitcoin Core developers
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "amount.h"
+#include "primitives/transaction.h"
+#include "txmempool.h"
+
+#include <list>
+#include <vector>
+
+static void AddTx(const CTransaction& tx, const CAmount& nFee, CTxMemPool& pool)
+{
+    int64_t nTime = 0;
+    unsigned int nHeight = 1;
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, nFee, nTime, 0.0, nHeight, pool.HasNoInputsOf(tx), 0));
+}
+
+// Build a single chain of nLength transactions, the first spending
+// outpoint and each following one spending the only output of the previous.
+static std::vector<CTransaction> CreateChain(size_t nLength, const COutPoint& outpoint)
+{
+    std::vector<CTransaction> vtx;
+    vtx.reserve(nLength);
+    uint256 prevHash;
+    for (size_t i = 0; i < nLength; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].scriptSig = CScript() << OP_1;
+        tx.vin[0].prevout = i == 0 ? outpoint : COutPoint(prevHash, 0);
+        tx.vout.resize(1);
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        tx.vout[0].nValue = (nLength - i) * COIN;
+        vtx.push_back(tx);
+        prevHash = vtx.back().GetHash();
+    }
+    return vtx;
+}
+
+// Build a root transaction with nWidth outputs and one child spending each
+// of them.
+static std::vector<CTransaction> CreateFanOut(size_t nWidth)
+{
+    std::vector<CTransaction> vtx;
+    vtx.reserve(nWidth + 1);
+    CMutableTransaction root;
+    root.vin.resize(1);
+    root.vin[0].scriptSig = CScript() << OP_1;
+    root.vin[0].prevout = COutPoint(uint256S("0x2"), 0);
+    root.vout.resize(nWidth);
+    for (size_t i = 0; i < nWidth; i++) {
+        root.vout[i].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        root.vout[i].nValue = COIN;
+    }
+    vtx.push_back(root);
+    const uint256 rootHash = vtx.back().GetHash();
+    for (size_t i = 0; i < nWidth; i++) {
+        CMutableTransaction child;
+        child.vin.resize(1);
+        child.vin[0].scriptSig = CScript() << OP_1;
+        child.vin[0].prevout = COutPoint(rootHash, i);
+        child.vout.resize(1);
+        child.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        child.vout[0].nValue = COIN / 2;
+        vtx.push_back(child);
+    }
+    return vtx;
+}
+
+// Add a long chain and evict it again through the root, which exercises the
+// ancestor walks done for every removed transaction.
+static void MempoolLongChain(benchmark::State& state)
+{
+    const std::vector<CTransaction> vtx = CreateChain(500, COutPoint(uint256S("0x1"), 0));
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        LOCK(pool.cs);
+        for (const CTransaction& tx : vtx)
+            AddTx(tx, 1000, pool);
+        std::list<CTransaction> removed;
+        pool.remove(vtx.front(), removed, true);
+    }
+}
+
+// Add a wide fan-out and confirm it in a single block, so that the whole
+// package leaves the pool in one batch.
+static void MempoolWideFanOut(benchmark::State& state)
+{
+    const std::vector<CTransaction> vtx = CreateFanOut(2000);
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        LOCK(pool.cs);
+        for (const CTransaction& tx : vtx)
+            AddTx(tx, 1000, pool);
+        std::list<CTransaction> conflicts;
+        pool.removeForBlock(vtx, 1, conflicts, false);
+    }
+}
+
+// Keep evicting the cheapest package of a chain-heavy pool, as happens when
+// the pool sits at -maxmempool under spam.
+static void MempoolTrimChains(benchmark::State& state)
+{
+    std::vector<std::vector<CTransaction> > vChains;
+    for (uint32_t i = 0; i < 20; i++)
+        vChains.push_back(CreateChain(25, COutPoint(uint256S("0x3"), i)));
+    CTxMemPool pool(CFeeRate(1000));
+    while (state.KeepRunning()) {
+        LOCK(pool.cs);
+        for (size_t i = 0; i < vChains.size(); i++) {
+            for (const CTransaction& tx : vChains[i])
+                AddTx(tx, 1000 + i, pool);
+        }
+        pool.TrimToSize(0);
+    }
+}
+
+BENCHMARK(MempoolLongChain);
+BENCHMARK(MempoolWideFanOut);
+BENCHMARK(MempoolTrimChains);
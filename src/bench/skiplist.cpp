@@ -0,0 +1,88 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chain.h"
+#include "random.h"
+
+#include <assert.h>
+#include <vector>
+
+static const int CHAIN_LENGTH = 200000;
+static const int QUERIES = 1000;
+
+static void BuildChain(std::vector<CBlockIndex>& vIndex)
+{
+    for (int i = 0; i < (int)vIndex.size(); i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].nTime = 1000000 + i * 60;
+        vIndex[i].BuildSkip();
+    }
+}
+
+// Random lookups from the tip, each walking the skiplist on its own
+static void SkipListGetAncestor(benchmark::State& state)
+{
+    std::vector<CBlockIndex> vIndex(CHAIN_LENGTH);
+    BuildChain(vIndex);
+    FastRandomContext rand(true);
+    std::vector<int> vHeights;
+    for (int i = 0; i < QUERIES; i++)
+        vHeights.push_back(rand.randrange(CHAIN_LENGTH));
+
+    const CBlockIndex& tip = vIndex.back();
+    while (state.KeepRunning()) {
+        for (int nHeight : vHeights)
+            assert(tip.GetAncestor(nHeight));
+    }
+}
+
+// The same lookups as one batch, each starting from the previous result
+static void SkipListGetAncestors(benchmark::State& state)
+{
+    std::vector<CBlockIndex> vIndex(CHAIN_LENGTH);
+    BuildChain(vIndex);
+    FastRandomContext rand(true);
+    std::vector<int> vHeights;
+    for (int i = 0; i < QUERIES; i++)
+        vHeights.push_back(rand.randrange(CHAIN_LENGTH));
+
+    const CBlockIndex& tip = vIndex.back();
+    while (state.KeepRunning()) {
+        assert(tip.GetAncestors(vHeights).size() == vHeights.size());
+    }
+}
+
+static void MedianTimePast(benchmark::State& state, bool fCached)
+{
+    std::vector<CBlockIndex> vIndex(CHAIN_LENGTH);
+    BuildChain(vIndex);
+    if (fCached) {
+        for (CBlockIndex& index : vIndex)
+            index.BuildMedianTimePast();
+    }
+
+    int64_t nSum = 0;
+    while (state.KeepRunning()) {
+        for (int i = CHAIN_LENGTH - QUERIES; i < CHAIN_LENGTH; i++)
+            nSum += vIndex[i].GetMedianTimePast();
+    }
+    assert(nSum);
+}
+
+static void MedianTimePastComputed(benchmark::State& state)
+{
+    MedianTimePast(state, false);
+}
+
+static void MedianTimePastCached(benchmark::State& state)
+{
+    MedianTimePast(state, true);
+}
+
+BENCHMARK(SkipListGetAncestor);
+BENCHMARK(SkipListGetAncestors);
+BENCHMARK(MedianTimePastComputed);
+BENCHMARK(MedianTimePastCached);
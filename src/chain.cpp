@@ -6,6 +6,12 @@
 
 #include "chain.h"
 #include "legacy/stakemodifier.h"  // for ComputeNextStakeModifier
+#include "memusage.h"
+#include "sync.h"
+
+#include <new>
+
+#include <boost/unordered_map.hpp>
 
 
 /**
@@ -72,7 +78,7 @@ CBlockIndex::CBlockIndex(const CBlock& block):
         nNonce{block.nNonce}
 {
     if(block.nVersion > 3 && block.nVersion < 7)
-        nAccumulatorCheckpoint = block.nAccumulatorCheckpoint;
+        SetAccumulatorCheckpoint(block.nAccumulatorCheckpoint);
     if (block.IsProofOfStake())
         SetProofOfStake();
 }
@@ -114,7 +120,7 @@ CBlockHeader CBlockIndex::GetBlockHeader() const
     block.nTime = nTime;
     block.nBits = nBits;
     block.nNonce = nNonce;
-    if (nVersion > 3 && nVersion < 7) block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
+    if (nVersion > 3 && nVersion < 7) block.nAccumulatorCheckpoint = GetAccumulatorCheckpoint();
     return block;
 }
 
@@ -143,6 +149,18 @@ int64_t CBlockIndex::MinPastBlockTime() const
 enum { nMedianTimeSpan = 11 };
 
 int64_t CBlockIndex::GetMedianTimePast() const
+{
+    if (nMedianTimePast)
+        return nMedianTimePast;
+    return ComputeMedianTimePast();
+}
+
+void CBlockIndex::BuildMedianTimePast()
+{
+    nMedianTimePast = ComputeMedianTimePast();
+}
+
+int64_t CBlockIndex::ComputeMedianTimePast() const
 {
     int64_t pmedian[nMedianTimeSpan];
     int64_t* pbegin = &pmedian[nMedianTimeSpan];
@@ -176,10 +194,9 @@ bool CBlockIndex::SetStakeEntropyBit(unsigned int nEntropyBit)
 // Sets V1 stake modifier (uint64_t)
 void CBlockIndex::SetStakeModifier(const uint64_t nStakeModifier, bool fGeneratedStakeModifier)
 {
-    vStakeModifier.clear();
-    const size_t modSize = sizeof(nStakeModifier);
-    vStakeModifier.resize(modSize);
-    std::memcpy(vStakeModifier.data(), &nStakeModifier, modSize);
+    stakeModifier.SetNull();
+    nStakeModifierSize = sizeof(nStakeModifier);
+    std::memcpy(stakeModifier.begin(), &nStakeModifier, sizeof(nStakeModifier));
     if (fGeneratedStakeModifier)
         nFlags |= BLOCK_STAKE_MODIFIER;
 
@@ -201,8 +218,8 @@ void CBlockIndex::SetNewStakeModifier()
 // Sets V2 stake modifiers (uint256)
 void CBlockIndex::SetStakeModifier(const uint256& nStakeModifier)
 {
-    vStakeModifier.clear();
-    vStakeModifier.insert(vStakeModifier.begin(), nStakeModifier.begin(), nStakeModifier.end());
+    stakeModifier = nStakeModifier;
+    nStakeModifierSize = sizeof(nStakeModifier);
 }
 
 // Generates and sets new V2 stake modifier
@@ -222,21 +239,34 @@ void CBlockIndex::SetNewStakeModifier(const uint256& prevoutId)
 // Returns V1 stake modifier (uint64_t)
 uint64_t CBlockIndex::GetStakeModifierV1() const
 {
-    if (vStakeModifier.empty() || Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
+    if (nStakeModifierSize == 0 || Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
         return 0;
     uint64_t nStakeModifier;
-    std::memcpy(&nStakeModifier, vStakeModifier.data(), vStakeModifier.size());
+    std::memcpy(&nStakeModifier, stakeModifier.begin(), sizeof(nStakeModifier));
     return nStakeModifier;
 }
 
 // Returns V2 stake modifier (uint256)
 uint256 CBlockIndex::GetStakeModifierV2() const
 {
-    if (vStakeModifier.empty() || !Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
+    if (nStakeModifierSize == 0 || !Params().GetConsensus().NetworkUpgradeActive(nHeight, Consensus::UPGRADE_V3_4))
         return UINT256_ZERO;
-    uint256 nStakeModifier;
-    std::memcpy(nStakeModifier.begin(), vStakeModifier.data(), vStakeModifier.size());
-    return nStakeModifier;
+    return stakeModifier;
+}
+
+std::vector<unsigned char> CBlockIndex::GetStakeModifierBytes() const
+{
+    return std::vector<unsigned char>(stakeModifier.begin(), stakeModifier.begin() + nStakeModifierSize);
+}
+
+bool CBlockIndex::SetStakeModifierBytes(const std::vector<unsigned char>& vchStakeModifier)
+{
+    if (vchStakeModifier.size() > sizeof(stakeModifier))
+        return false;
+    stakeModifier.SetNull();
+    nStakeModifierSize = vchStakeModifier.size();
+    std::copy(vchStakeModifier.begin(), vchStakeModifier.end(), stakeModifier.begin());
+    return true;
 }
 
 //! Check whether this block index entry is valid up to the passed validity level.
@@ -266,4 +296,103 @@ bool CBlockIndex::RaiseValidity(enum BlockStatus nUpTo)
  * CBlockIndex - Legacy Zerocoin
  */
 
+/*
+ * CBlockIndexAccCheckpoint
+ */
+namespace {
+
+typedef boost::unordered_map<const CBlockIndexAccCheckpoint*, uint256> AccCheckpointMap;
+
+struct CAccCheckpointTable
+{
+    RecursiveMutex cs;
+    AccCheckpointMap map;
+};
+
+CAccCheckpointTable& AccCheckpointTable()
+{
+    static CAccCheckpointTable table;
+    return table;
+}
+
+} // anon namespace
+
+uint256 CBlockIndexAccCheckpoint::Get() const
+{
+    if (!fSet)
+        return UINT256_ZERO;
+    CAccCheckpointTable& table = AccCheckpointTable();
+    LOCK(table.cs);
+    AccCheckpointMap::const_iterator it = table.map.find(this);
+    return it == table.map.end() ? UINT256_ZERO : it->second;
+}
 
+void CBlockIndexAccCheckpoint::Set(const uint256& nCheckpoint)
+{
+    if (nCheckpoint.IsNull() && !fSet)
+        return;
+    CAccCheckpointTable& table = AccCheckpointTable();
+    LOCK(table.cs);
+    if (nCheckpoint.IsNull()) {
+        table.map.erase(this);
+        fSet = false;
+    } else {
+        table.map[this] = nCheckpoint;
+        fSet = true;
+    }
+}
+
+size_t CBlockIndexAccCheckpoint::Count()
+{
+    CAccCheckpointTable& table = AccCheckpointTable();
+    LOCK(table.cs);
+    return table.map.size();
+}
+
+size_t CBlockIndexAccCheckpoint::DynamicMemoryUsage()
+{
+    CAccCheckpointTable& table = AccCheckpointTable();
+    LOCK(table.cs);
+    return memusage::DynamicUsage(table.map);
+}
+
+/*
+ * CBlockIndexArena
+ */
+void* CBlockIndexArena::Allocate()
+{
+    if (nUsedInLastChunk == ENTRIES_PER_CHUNK) {
+        vChunks.push_back(static_cast<CBlockIndex*>(::operator new(sizeof(CBlockIndex) * ENTRIES_PER_CHUNK)));
+        nUsedInLastChunk = 0;
+    }
+    nEntries++;
+    return vChunks.back() + nUsedInLastChunk++;
+}
+
+CBlockIndex* CBlockIndexArena::New()
+{
+    return new (Allocate()) CBlockIndex();
+}
+
+CBlockIndex* CBlockIndexArena::New(const CBlock& block)
+{
+    return new (Allocate()) CBlockIndex(block);
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vChunks.size(); i++) {
+        const size_t nUsed = (i + 1 == vChunks.size()) ? nUsedInLastChunk : ENTRIES_PER_CHUNK;
+        for (size_t j = 0; j < nUsed; j++)
+            vChunks[i][j].~CBlockIndex();
+        ::operator delete(vChunks[i]);
+    }
+    std::vector<CBlockIndex*>().swap(vChunks);
+    nUsedInLastChunk = ENTRIES_PER_CHUNK;
+    nEntries = 0;
+}
+
+size_t CBlockIndexArena::DynamicMemoryUsage() const
+{
+    return vChunks.size() * memusage::MallocUsage(sizeof(CBlockIndex) * ENTRIES_PER_CHUNK) + memusage::DynamicUsage(vChunks);
+}
@@ -158,6 +158,43 @@ enum BlockStatus {
     BLOCK_FAILED_VALID = 32, //! stage after last reached validness failed
     BLOCK_FAILED_CHILD = 64, //! descends from failed block
     BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
+
+    BLOCK_ASSUMED_VALID = 128, //! loaded from a UTXO snapshot, validity taken from it and block data never downloaded
+};
+
+/**
+ * Accumulator checkpoint of a block index entry. Only zerocoin era headers
+ * (version 4 to 6) have one, so rather than a uint256 in every entry it is
+ * kept in a side table, keyed by the address of this one-byte member.
+ */
+class CBlockIndexAccCheckpoint
+{
+public:
+    CBlockIndexAccCheckpoint() {}
+    CBlockIndexAccCheckpoint(const CBlockIndexAccCheckpoint& other) { Set(other.Get()); }
+    CBlockIndexAccCheckpoint& operator=(const CBlockIndexAccCheckpoint& other)
+    {
+        if (this != &other)
+            Set(other.Get());
+        return *this;
+    }
+    ~CBlockIndexAccCheckpoint()
+    {
+        if (fSet)
+            Set(UINT256_ZERO);
+    }
+
+    uint256 Get() const;
+    //! Setting a null checkpoint removes the entry from the side table
+    void Set(const uint256& nCheckpoint);
+
+    //! Number of entries in the side table
+    static size_t Count();
+    //! Memory used by the side table
+    static size_t DynamicMemoryUsage();
+
+private:
+    bool fSet{false};
 };
 
 // BlockIndex flags
@@ -212,9 +249,10 @@ public:
     unsigned int nStatus{0};
 
     // proof-of-stake specific fields
-    // char vector holding the stake modifier bytes. It is empty for PoW blocks.
-    // Modifier V1 is 64 bit while modifier V2 is 256 bit.
-    std::vector<unsigned char> vStakeModifier{};
+    // stake modifier bytes, stored inline. nStakeModifierSize is 0 for PoW blocks,
+    // 8 for modifier V1 (64 bit) and 32 for modifier V2 (256 bit).
+    uint256 stakeModifier{};
+    uint8_t nStakeModifierSize{0};
     unsigned int nFlags{0};
 
     //! block header
@@ -223,11 +261,14 @@ public:
     unsigned int nTime{0};
     unsigned int nBits{0};
     unsigned int nNonce{0};
-    uint256 nAccumulatorCheckpoint{};
+    CBlockIndexAccCheckpoint accCheckpoint{};
 
     //! (memory only) Sequential id assigned to distinguish order in which blocks are received.
     uint32_t nSequenceId{0};
 
+    //! (memory only) Median time past, cached by BuildMedianTimePast once the entry joins the block tree
+    unsigned int nMedianTimePast{0};
+
     CBlockIndex() {}
     CBlockIndex(const CBlock& block);
 
@@ -257,6 +298,13 @@ public:
     void SetNewStakeModifier(const uint256& prevoutId);     // generates and sets new v2 modifier
     uint64_t GetStakeModifierV1() const;
     uint256 GetStakeModifierV2() const;
+    //! Stake modifier as serialized in the block index database
+    std::vector<unsigned char> GetStakeModifierBytes() const;
+    bool SetStakeModifierBytes(const std::vector<unsigned char>& vchStakeModifier);
+
+    //! Accumulator checkpoint of zerocoin era headers, null otherwise
+    uint256 GetAccumulatorCheckpoint() const { return accCheckpoint.Get(); }
+    void SetAccumulatorCheckpoint(const uint256& nCheckpoint) { accCheckpoint.Set(nCheckpoint); }
 
     //! Check whether this block index entry is valid up to the passed validity level.
     bool IsValid(enum BlockStatus nUpTo = BLOCK_VALID_TRANSACTIONS) const;
@@ -265,9 +313,50 @@ public:
     bool RaiseValidity(enum BlockStatus nUpTo);
     //! Build the skiplist pointer for this entry.
     void BuildSkip();
+    //! Cache the median time past of this entry, once pprev and nTime are set.
+    void BuildMedianTimePast();
     //! Efficiently find an ancestor of this block.
     CBlockIndex* GetAncestor(int height);
     const CBlockIndex* GetAncestor(int height) const;
+    //! Find the ancestors at several heights (in the order given, NULL for heights out of
+    //! range), walking down the skiplist once from each to the next lower one.
+    std::vector<const CBlockIndex*> GetAncestors(const std::vector<int>& vHeights) const;
+
+private:
+    int64_t ComputeMedianTimePast() const;
+};
+
+/**
+ * Allocates block index entries in large contiguous chunks rather than with
+ * one heap allocation each. Entries stay valid until Clear(), which
+ * destroys all of them at once. Not thread safe, callers hold cs_main.
+ */
+class CBlockIndexArena
+{
+public:
+    static const size_t ENTRIES_PER_CHUNK = 4096;
+
+    CBlockIndexArena() : nUsedInLastChunk(ENTRIES_PER_CHUNK), nEntries(0) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    CBlockIndex* New();
+    CBlockIndex* New(const CBlock& block);
+
+    //! Destroy every entry and release the chunks
+    void Clear();
+
+    size_t Size() const { return nEntries; }
+    size_t DynamicMemoryUsage() const;
+
+private:
+    std::vector<CBlockIndex*> vChunks;
+    size_t nUsedInLastChunk;
+    size_t nEntries;
+
+    CBlockIndexArena(const CBlockIndexArena&);
+    CBlockIndexArena& operator=(const CBlockIndexArena&);
+
+    void* Allocate();
 };
 
 /** Used to marshal pointers into hashes for db storage. */
@@ -275,20 +364,25 @@ public:
 // New serialization introduced with 1.0.0
 static const int DBI_OLD_SER_VERSION = 1000000;
 static const int DBI_SER_VERSION_NO_ZC = 1000100;   // removes mapZerocoinSupply, nMoneySupply
+static const int DBI_SER_VERSION_HASH = 1000200;    // stores the block hash, whose PoW was checked when written
 
 class CDiskBlockIndex : public CBlockIndex
 {
 public:
     uint256 hashPrev;
+    //! Hash of the block, null when read from a record older than DBI_SER_VERSION_HASH
+    uint256 hashBlock;
 
     CDiskBlockIndex()
     {
         hashPrev = UINT256_ZERO;
+        hashBlock = UINT256_ZERO;
     }
 
     explicit CDiskBlockIndex(const CBlockIndex* pindex) : CBlockIndex(*pindex)
     {
         hashPrev = (pprev ? pprev->GetBlockHash() : UINT256_ZERO);
+        hashBlock = pindex->GetBlockHash();
     }
 
     ADD_SERIALIZE_METHODS;
@@ -296,10 +390,18 @@ public:
     template <typename Stream, typename Operation>
     inline void SerializationOp(Stream& s, Operation ser_action)
     {
-        int nSerVersion = s.GetVersion();
+        // Records are always written in the latest format, whatever the client version
+        int nSerVersion = ser_action.ForRead() ? s.GetVersion() : std::max(s.GetVersion(), DBI_SER_VERSION_HASH);
         if (!(s.GetType() & SER_GETHASH))
             READWRITE(VARINT(nSerVersion));
 
+        std::vector<unsigned char> vStakeModifier;
+        uint256 nAccumulatorCheckpoint;
+        if (!ser_action.ForRead()) {
+            vStakeModifier = GetStakeModifierBytes();
+            nAccumulatorCheckpoint = GetAccumulatorCheckpoint();
+        }
+
         READWRITE(VARINT(nHeight));
         READWRITE(VARINT(nStatus));
         READWRITE(VARINT(nTx));
@@ -322,6 +424,13 @@ public:
             READWRITE(nNonce);
             if(this->nVersion > 3 && this->nVersion < 7)
                 READWRITE(nAccumulatorCheckpoint);
+            if (nSerVersion >= DBI_SER_VERSION_HASH)
+                READWRITE(hashBlock);
+            if (ser_action.ForRead()) {
+                if (!SetStakeModifierBytes(vStakeModifier))
+                    throw std::ios_base::failure("CDiskBlockIndex: invalid stake modifier size");
+                SetAccumulatorCheckpoint(nAccumulatorCheckpoint);
+            }
 
         } else if (nSerVersion > DBI_OLD_SER_VERSION && ser_action.ForRead()) {
             // Serialization with CLIENT_VERSION = 1000000
@@ -340,6 +449,9 @@ public:
                 READWRITE(mapZerocoinSupply);
                 if(this->nVersion < 7) READWRITE(nAccumulatorCheckpoint);
             }
+            if (!SetStakeModifierBytes(vStakeModifier))
+                throw std::ios_base::failure("CDiskBlockIndex: invalid stake modifier size");
+            SetAccumulatorCheckpoint(nAccumulatorCheckpoint);
 
         } else if (ser_action.ForRead()) {
             // Serialization with CLIENT_VERSION < 1000000
@@ -378,11 +490,24 @@ public:
                 READWRITE(mapZerocoinSupply);
                 READWRITE(vMintDenominationsInBlock);
             }
+            SetAccumulatorCheckpoint(nAccumulatorCheckpoint);
         }
     }
 
 
+    bool HasStoredHash() const
+    {
+        return !hashBlock.IsNull();
+    }
+
     uint256 GetBlockHash() const
+    {
+        if (HasStoredHash())
+            return hashBlock;
+        return ComputeBlockHash();
+    }
+
+    uint256 ComputeBlockHash() const
     {
         CBlockHeader block;
         block.nVersion = nVersion;
@@ -392,7 +517,7 @@ public:
         block.nBits = nBits;
         block.nNonce = nNonce;
         if (nVersion > 3 && nVersion < 7)
-            block.nAccumulatorCheckpoint = nAccumulatorCheckpoint;
+            block.nAccumulatorCheckpoint = GetAccumulatorCheckpoint();
         return block.GetHash();
     }
 
@@ -442,6 +567,9 @@ public:
             return;
         }
 
+        std::vector<unsigned char> vStakeModifier;
+        uint256 nAccumulatorCheckpoint;
+
         READWRITE(VARINT(nHeight));
         READWRITE(VARINT(nStatus));
         READWRITE(VARINT(nTx));
@@ -467,6 +595,8 @@ public:
                 READWRITE(mapZerocoinSupply);
                 if(this->nVersion < 7) READWRITE(nAccumulatorCheckpoint);
             }
+            if (!SetStakeModifierBytes(vStakeModifier))
+                throw std::ios_base::failure("CLegacyBlockIndex: invalid stake modifier size");
 
         } else {
             // Serialization with CLIENT_VERSION <= 1000000
@@ -495,6 +625,7 @@ public:
                 READWRITE(vMintDenominationsInBlock);
             }
         }
+        SetAccumulatorCheckpoint(nAccumulatorCheckpoint);
     }
 };
 
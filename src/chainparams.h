@@ -15,6 +15,7 @@
 #include "protocol.h"
 #include "uint256.h"
 
+#include <map>
 #include <vector>
 
 typedef unsigned char MessageStartChars[MESSAGE_START_SIZE];
@@ -25,6 +26,17 @@ struct CDNSSeedData {
     CDNSSeedData(const std::string& strName, const std::string& strHost, bool supportsServiceBitsFilteringIn = false) : name(strName), host(strHost), supportsServiceBitsFiltering(supportsServiceBitsFilteringIn) {}
 };
 
+/**
+ * A UTXO snapshot trusted by this release (see dumptxoutset and loadtxoutset):
+ * the block it was taken at and the checksum of the snapshot file.
+ */
+struct CAssumeutxoData {
+    uint256 hashBlock;
+    uint256 hashSnapshot;
+};
+
+typedef std::map<int, CAssumeutxoData> MapAssumeutxo;
+
 struct SeedSpec6 {
     uint8_t addr[16];
     uint16_t port;
@@ -71,6 +83,8 @@ public:
     const std::vector<unsigned char>& Base58Prefix(Base58Type type) const { return base58Prefixes[type]; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     virtual const Checkpoints::CCheckpointData& Checkpoints() const = 0;
+    /** Snapshots that loadtxoutset accepts, by height */
+    const MapAssumeutxo& Assumeutxo() const { return mapAssumeutxo; }
 
     CBaseChainParams::Network NetworkID() const { return networkID; }
     bool IsRegTestNet() const { return NetworkID() == CBaseChainParams::REGTEST; }
@@ -88,6 +102,8 @@ protected:
     std::vector<CDNSSeedData> vSeeds;
     std::vector<unsigned char> base58Prefixes[MAX_BASE58_TYPES];
     std::vector<SeedSpec6> vFixedSeeds;
+    //! Filled in at release time from the output of dumptxoutset
+    MapAssumeutxo mapAssumeutxo;
 };
 
 /**
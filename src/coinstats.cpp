@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+
+/// Serialization parameters of the MuHash set elements.
+static const int COINSTATS_SER_TYPE = SER_NETWORK;
+static const int COINSTATS_SER_VERSION = 0;
+
+uint64_t GetBogoSize(const CScript& scriptPubKey)
+{
+    return 32 /* txid */ +
+           4 /* vout index */ +
+           4 /* height + coinbase */ +
+           8 /* amount */ +
+           2 /* scriptPubKey len */ +
+           scriptPubKey.size() /* scriptPubKey */;
+}
+
+void ApplyCoinToMuHash(MuHash3072& muhash, const COutPoint& outpoint, const CTxOut& out, bool fSpent)
+{
+    CDataStream ss(COINSTATS_SER_TYPE, COINSTATS_SER_VERSION);
+    ss << outpoint << out;
+    const unsigned char* data = (const unsigned char*)&ss[0];
+    if (fSpent)
+        muhash.Remove(data, ss.size());
+    else
+        muhash.Insert(data, ss.size());
+}
+
+void CCoinStatsEntry::ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, int nBlockHeight)
+{
+    nHeight = nBlockHeight;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+
+        // Spent outputs, as recorded by UpdateCoins. An undo record carries a
+        // height only when it spent the last unspent output of its transaction.
+        if (!tx.IsCoinBase() && !tx.HasZerocoinSpendInputs()) {
+            const CTxUndo& txundo = blockundo.vtxundo[i - 1];
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const CTxInUndo& undo = txundo.vprevout[j];
+                ApplyCoinToMuHash(muhash, tx.vin[j].prevout, undo.txout, true);
+                nTransactionOutputs--;
+                nBogoSize -= GetBogoSize(undo.txout.scriptPubKey);
+                nTotalAmount -= undo.txout.nValue;
+                if (undo.nHeight != 0)
+                    nTransactions--;
+            }
+        }
+
+        // New outputs, minus the provably unspendable ones (see CCoins::ClearUnspendable)
+        const uint256& hash = tx.GetHash();
+        bool fAdded = false;
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            const CTxOut& out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable())
+                continue;
+            ApplyCoinToMuHash(muhash, COutPoint(hash, j), out, false);
+            nTransactionOutputs++;
+            nBogoSize += GetBogoSize(out.scriptPubKey);
+            nTotalAmount += out.nValue;
+            fAdded = true;
+        }
+        if (fAdded)
+            nTransactions++;
+    }
+
+    // Normalizing the accumulator keeps the stored entries small and makes
+    // the per-block hash available without any further work.
+    muhash.Finalize(hashMuHash);
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TARIAN_COINSTATS_H
+#define TARIAN_COINSTATS_H
+
+#include "amount.h"
+#include "crypto/muhash.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+class CBlock;
+class CBlockUndo;
+class COutPoint;
+class CScript;
+class CTxOut;
+
+/** Rough per-output footprint used for the "bogosize" statistic, independent of the database encoding */
+uint64_t GetBogoSize(const CScript& scriptPubKey);
+
+/** Add or remove an unspent output to a MuHash of the UTXO set */
+void ApplyCoinToMuHash(MuHash3072& muhash, const COutPoint& outpoint, const CTxOut& out, bool fSpent);
+
+/**
+ * Statistics of the UTXO set as of a given block, as kept by the coin stats
+ * index (-coinstatsindex). Each entry is derived from the parent's entry and
+ * the block's own outputs and undo data, so gettxoutsetinfo can be answered
+ * for any indexed block without walking the chainstate.
+ */
+class CCoinStatsEntry
+{
+public:
+    int nHeight;
+    uint64_t nTransactions;
+    uint64_t nTransactionOutputs;
+    uint64_t nBogoSize;
+    CAmount nTotalAmount;
+    //! Finalized MuHash of the set, kept next to the running accumulator
+    uint256 hashMuHash;
+    MuHash3072 muhash;
+
+    CCoinStatsEntry() : nHeight(0), nTransactions(0), nTransactionOutputs(0), nBogoSize(0), nTotalAmount(0) {}
+
+    /** Turn the entry of a block's parent into the entry of the block itself. */
+    void ApplyBlock(const CBlock& block, const CBlockUndo& blockundo, int nBlockHeight);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nHeight);
+        READWRITE(nTransactions);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nBogoSize);
+        READWRITE(nTotalAmount);
+        READWRITE(hashMuHash);
+        READWRITE(muhash);
+    }
+};
+
+#endif // TARIAN_COINSTATS_H
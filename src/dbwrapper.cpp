@@ -8,6 +8,11 @@
 
 #include <boost/scoped_ptr.hpp>
 
+#include <atomic>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
 #include <leveldb/filter_policy.h>
@@ -15,14 +20,55 @@
 #include <stdint.h>
 
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+namespace dbwrapper_private {
+
+/** LRU block cache that counts how often lookups find what they look for */
+class CountingCache : public leveldb::Cache
+{
+private:
+    leveldb::Cache* pcache;
+
+public:
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+
+    CountingCache(size_t nCapacity) : pcache(leveldb::NewLRUCache(nCapacity)), nHits(0), nMisses(0) {}
+    ~CountingCache() { delete pcache; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value))
+    {
+        return pcache->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key)
+    {
+        Handle* handle = pcache->Lookup(key);
+        if (handle)
+            nHits++;
+        else
+            nMisses++;
+        return handle;
+    }
+
+    void Release(Handle* handle) { pcache->Release(handle); }
+    void* Value(Handle* handle) { return pcache->Value(handle); }
+    void Erase(const leveldb::Slice& key) { pcache->Erase(key); }
+    uint64_t NewId() { return pcache->NewId(); }
+    void Prune() { pcache->Prune(); }
+    size_t TotalCharge() const { return pcache->TotalCharge(); }
+};
+
+};
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBOptions& dbOptions)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    options.write_buffer_size = dbOptions.nWriteBufferSize ? dbOptions.nWriteBufferSize : nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
+    options.block_size = dbOptions.nBlockSize;
+    options.max_file_size = dbOptions.nMaxFileSize;
     options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.compression = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -31,29 +77,32 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory, bool fWipe)
+CDBWrapper::CDBWrapper(const fs::path& path, size_t nCacheSizeIn, bool fMemory, bool fWipe, const CDBOptions& dbOptionsIn)
+    : strPath(path.string()), nCacheSize(nCacheSizeIn), dbOptions(dbOptionsIn), fBulkLoad(false)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbOptions);
+    pcache = new dbwrapper_private::CountingCache(nCacheSize / 2);
+    options.block_cache = pcache;
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
         options.env = penv;
     } else {
         if (fWipe) {
-            LogPrintf("Wiping LevelDB in %s\n", path.string());
-            leveldb::Status result = leveldb::DestroyDB(path.string(), options);
+            LogPrintf("Wiping LevelDB in %s\n", strPath);
+            leveldb::Status result = leveldb::DestroyDB(strPath, options);
             dbwrapper_private::HandleError(result);
         }
         TryCreateDirectory(path);
-        LogPrintf("Opening LevelDB in %s\n", path.string());
+        LogPrintf("Opening LevelDB in %s\n", strPath);
     }
-    leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
-    dbwrapper_private::HandleError(status);
+    pdb = NULL;
+    Open();
     LogPrintf("Opened LevelDB successfully\n");
 }
 
@@ -63,12 +112,93 @@ CDBWrapper::~CDBWrapper()
     pdb = NULL;
     delete options.filter_policy;
     options.filter_policy = NULL;
-    delete options.block_cache;
+    delete pcache;
+    pcache = NULL;
     options.block_cache = NULL;
     delete penv;
     options.env = NULL;
 }
 
+void CDBWrapper::Open()
+{
+    options.write_buffer_size = GetOptions(nCacheSize, dbOptions).write_buffer_size;
+    if (fBulkLoad)
+        options.write_buffer_size = std::max(options.write_buffer_size, dbOptions.nBulkWriteBufferSize);
+    leveldb::Status status = leveldb::DB::Open(options, strPath, &pdb);
+    dbwrapper_private::HandleError(status);
+}
+
+void CDBWrapper::SetBulkLoad(bool fBulkLoadIn)
+{
+    if (fBulkLoad == fBulkLoadIn)
+        return;
+    // Write buffers are sized when opening, so this takes a reopen. Closing
+    // leaves the write buffer in the log, from which it is recovered.
+    delete pdb;
+    pdb = NULL;
+    fBulkLoad = fBulkLoadIn;
+    Open();
+    LogPrint(BCLog::LEVELDB, "%s bulk loading of %s\n", fBulkLoad ? "Started" : "Finished", strPath);
+}
+
+void CDBWrapper::Compact()
+{
+    int64_t nStart = GetTimeMillis();
+    pdb->CompactRange(NULL, NULL);
+    LogPrint(BCLog::LEVELDB, "Compacted %s, %dms\n", strPath, GetTimeMillis() - nStart);
+}
+
+void CDBWrapper::GetStats(CDBStats& stats) const
+{
+    stats.vLevels.clear();
+    std::string strValue;
+
+    // Table files, one " number:size[smallest .. largest]" line each under a "--- level N ---" line
+    if (pdb->GetProperty("leveldb.sstables", &strValue)) {
+        std::istringstream ss(strValue);
+        std::string strLine;
+        int nLevel = -1;
+        while (std::getline(ss, strLine)) {
+            if (strLine.compare(0, 10, "--- level ") == 0) {
+                nLevel = atoi(strLine.c_str() + 10);
+                if (nLevel >= 0 && (size_t)nLevel >= stats.vLevels.size())
+                    stats.vLevels.resize(nLevel + 1);
+                continue;
+            }
+            size_t nColon = strLine.find(':');
+            if (nLevel < 0 || nColon == std::string::npos)
+                continue;
+            stats.vLevels[nLevel].nFiles++;
+            stats.vLevels[nLevel].nBytes += strtoull(strLine.c_str() + nColon + 1, NULL, 10);
+        }
+    }
+
+    // Compaction work, a table row per level that had any: level, files, MB, seconds, MB read, MB written
+    if (pdb->GetProperty("leveldb.stats", &strValue)) {
+        std::istringstream ss(strValue);
+        std::string strLine;
+        while (std::getline(ss, strLine)) {
+            int nLevel, nFiles;
+            double dSize, dTime, dRead, dWritten;
+            if (sscanf(strLine.c_str(), "%d %d %lf %lf %lf %lf", &nLevel, &nFiles, &dSize, &dTime, &dRead, &dWritten) != 6)
+                continue;
+            if (nLevel < 0 || (size_t)nLevel >= stats.vLevels.size())
+                continue;
+            stats.vLevels[nLevel].dCompactionTime = dTime;
+            stats.vLevels[nLevel].nCompactionRead = dRead * 1048576;
+            stats.vLevels[nLevel].nCompactionWritten = dWritten * 1048576;
+        }
+    }
+
+    stats.nMemoryUsage = 0;
+    if (pdb->GetProperty("leveldb.approximate-memory-usage", &strValue))
+        stats.nMemoryUsage = strtoull(strValue.c_str(), NULL, 10);
+    stats.nCacheHits = pcache->nHits;
+    stats.nCacheMisses = pcache->nMisses;
+    stats.nCacheUsage = pcache->TotalCharge();
+    stats.fBulkLoad = fBulkLoad;
+}
+
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync)
 {
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch);
@@ -29,6 +29,47 @@ public:
 
 class CDBWrapper;
 
+/** Tuning of a database, chosen to suit what it stores (see the profiles in txdb.cpp) */
+struct CDBOptions {
+    //! approximate size of the data packed per block, before compression
+    size_t nBlockSize;
+    //! size of the in-memory write buffer, or 0 for a quarter of the cache
+    size_t nWriteBufferSize;
+    //! size of the write buffer while bulk loading
+    size_t nBulkWriteBufferSize;
+    //! size of the table files compactions produce
+    size_t nMaxFileSize;
+    //! number of table files kept open
+    int nMaxOpenFiles;
+    //! compress blocks with snappy, when LevelDB was built with it
+    bool fCompression;
+
+    CDBOptions() : nBlockSize(4096), nWriteBufferSize(0), nBulkWriteBufferSize(0), nMaxFileSize(2 << 20), nMaxOpenFiles(64), fCompression(false) {}
+};
+
+/** Files and compaction work of one level of a database */
+struct CDBLevelStats {
+    int nFiles;
+    uint64_t nBytes;
+    double dCompactionTime;
+    uint64_t nCompactionRead;
+    uint64_t nCompactionWritten;
+
+    CDBLevelStats() : nFiles(0), nBytes(0), dCompactionTime(0), nCompactionRead(0), nCompactionWritten(0) {}
+};
+
+/** Activity of a database, as reported by LevelDB and its block cache */
+struct CDBStats {
+    std::vector<CDBLevelStats> vLevels;
+    uint64_t nMemoryUsage;
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+    size_t nCacheUsage;
+    bool fBulkLoad;
+
+    CDBStats() : nMemoryUsage(0), nCacheHits(0), nCacheMisses(0), nCacheUsage(0), fBulkLoad(false) {}
+};
+
 /** These should be considered an implementation detail of the specific database.
  */
 namespace dbwrapper_private {
@@ -37,6 +78,8 @@ namespace dbwrapper_private {
  */
 void HandleError(const leveldb::Status& status);
 
+class CountingCache;
+
 };
 
 
@@ -50,6 +93,11 @@ private:
 
 public:
 
+    void Clear()
+    {
+        batch.Clear();
+    }
+
     template <typename K, typename V>
     void Write(const K& key, const V& value)
     {
@@ -66,6 +114,12 @@ public:
         batch.Put(slKey, slValue);
     }
 
+    /** Write an already serialized record, as copied out with CDBIterator::GetKeyBytes/GetValueBytes */
+    void WriteBytes(const std::vector<char>& key, const std::vector<char>& value)
+    {
+        batch.Put(leveldb::Slice(key.data(), key.size()), leveldb::Slice(value.data(), value.size()));
+    }
+
     template <typename K>
     void Erase(const K& key)
     {
@@ -119,6 +173,12 @@ public:
         return piter->key().size();
     }
 
+    /** Copy the serialized key */
+    void GetKeyBytes(std::vector<char>& key) {
+        leveldb::Slice slKey = piter->key();
+        key.assign(slKey.data(), slKey.data() + slKey.size());
+    }
+
     template<typename V> bool GetValue(V& value) {
         leveldb::Slice slValue = piter->value();
         try {
@@ -134,6 +194,12 @@ public:
         return piter->value().size();
     }
 
+    /** Copy the serialized value, to deserialize it later or elsewhere */
+    void GetValueBytes(std::vector<char>& value) {
+        leveldb::Slice slValue = piter->value();
+        value.assign(slValue.data(), slValue.data() + slValue.size());
+    }
+
 };
 
 class CDBWrapper
@@ -160,14 +226,27 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! block cache of the database, counting its hits and misses
+    dbwrapper_private::CountingCache* pcache;
+
+    //! location of the database
+    std::string strPath;
+
+    size_t nCacheSize;
+    CDBOptions dbOptions;
+    bool fBulkLoad;
+
+    void Open();
+
 public:
     /**
      * @param[in] path        Location in the filesystem where leveldb data will be stored.
      * @param[in] nCacheSize  Configures various leveldb cache settings.
      * @param[in] fMemory     If true, use leveldb's memory environment.
      * @param[in] fWipe       If true, remove all existing data.
+     * @param[in] dbOptions   Tuning of the database.
      */
-    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CDBWrapper(const fs::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, const CDBOptions& dbOptions = CDBOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -255,6 +334,19 @@ public:
     */
     bool IsEmpty();
 
+    /**
+     * Reopen the database with a large write buffer before writing a lot of
+     * data at once, or back with its normal options afterwards. The caller
+     * must make sure nothing else uses the database meanwhile, and no
+     * iterator may be open.
+     */
+    void SetBulkLoad(bool fBulkLoadIn);
+
+    /** Compact the whole database, as is worth doing after a bulk load. Other users may go on meanwhile. */
+    void Compact();
+
+    void GetStats(CDBStats& stats) const;
+
 };
 
 #endif // BITCOIN_DBWRAPPER_H
@@ -87,6 +87,36 @@ bool CStakeKernel::CheckKernelHash(bool fSkipLog) const
  * PoS Validation
  */
 
+// Find the output spent by the coinstake of a block and the height of its
+// transaction without a transaction index or block reads: in the chainstate
+// while the output is unspent, else in the undo data of the block once it is
+// connected, which holds the height when the output was the last unspent one.
+static bool GetStakePrevoutFromCoins(const CBlock& block, const CBlockIndex* pindexPrev, CTxOut& out, int& nHeight)
+{
+    LOCK(cs_main);
+    const COutPoint& prevout = block.vtx[1].vin[0].prevout;
+    const CCoins* coins = pcoinsTip->AccessCoins(prevout.hash);
+    if (coins && coins->IsAvailable(prevout.n)) {
+        out = coins->vout[prevout.n];
+        nHeight = coins->nHeight;
+        return true;
+    }
+
+    const CBlockIndex* pindex = chainActive[pindexPrev->nHeight + 1];
+    if (!pindex || pindex->pprev != pindexPrev || !(pindex->nStatus & BLOCK_HAVE_UNDO) || pindex->GetBlockHash() != block.GetHash())
+        return false;
+    CBlockUndo blockUndo;
+    if (!blockUndo.ReadFromDisk(pindex->GetUndoPos(), pindexPrev->GetBlockHash()) ||
+            blockUndo.vtxundo.empty() || blockUndo.vtxundo[0].vprevout.empty())
+        return false;
+    const CTxInUndo& undo = blockUndo.vtxundo[0].vprevout[0];
+    if (undo.nHeight <= 0)
+        return false;
+    out = undo.txout;
+    nHeight = undo.nHeight;
+    return true;
+}
+
 // helper function for CheckProofOfStake and GetStakeKernelHash
 bool LoadStakeInput(const CBlock& block, const CBlockIndex* pindexPrev, std::unique_ptr<CStakeInput>& stake)
 {
@@ -107,6 +137,13 @@ bool LoadStakeInput(const CBlock& block, const CBlockIndex* pindexPrev, std::uni
 
     // Construct the stakeinput object
     const CTxIn& txin = block.vtx[1].vin[0];
+    CTxOut out;
+    int nHeightFrom;
+    if (!txin.IsZerocoinSpend() && GetStakePrevoutFromCoins(block, pindexPrev, out, nHeightFrom)) {
+        CTarnStake* tarnStake = new CTarnStake();
+        stake.reset(tarnStake);
+        return tarnStake->InitFromCoin(txin.prevout, out, chainActive[nHeightFrom]);
+    }
     stake = txin.IsZerocoinSpend() ?
             std::unique_ptr<CStakeInput>(new CLegacyZTarnStake()) :
             std::unique_ptr<CStakeInput>(new CTarnStake());
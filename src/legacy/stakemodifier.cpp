@@ -7,6 +7,9 @@
 
 #include "legacy/stakemodifier.h"
 #include "main.h"   // mapBlockIndex, chainActive
+#include "sync.h"
+
+#include <deque>
 
 /*
  * Old Modifier - Only for IBD
@@ -16,6 +19,61 @@ static const unsigned int MODIFIER_INTERVAL = 60;
 static const int MODIFIER_INTERVAL_RATIO = 3;
 static const int64_t OLD_MODIFIER_INTERVAL = 2087;
 
+/** A block taking part in a modifier selection, ordered by timestamp then hash */
+struct CModifierCandidate {
+    int64_t nTime;
+    uint256 hash;
+    const CBlockIndex* pindex;
+
+    bool operator<(const CModifierCandidate& other) const
+    {
+        return nTime < other.nTime || (nTime == other.nTime && hash < other.hash);
+    }
+};
+
+/**
+ * The candidates of the last modifier computation. The candidates of a block
+ * are its ancestors back to the first one older than the selection interval
+ * start, which only moves forward from a block to its child, so the next
+ * block of a chain trims the oldest of them and adds its parent.
+ */
+struct CModifierCandidateCache {
+    const CBlockIndex* pindexPrev = nullptr;
+    int64_t nSelectionIntervalStart = 0;
+    //! newest first
+    std::deque<const CBlockIndex*> chain;
+    std::vector<CModifierCandidate> vSortedByTimestamp;
+    int nHeightFirstCandidate = 0;
+};
+
+/** Modifier found for a stake origin, and the block it was taken from */
+struct COldModifierEntry {
+    const CBlockIndex* pindexModifier;
+    uint64_t nStakeModifier;
+};
+
+static const size_t MAX_OLD_MODIFIER_ENTRIES = 10000;
+
+static RecursiveMutex cs_modifierCache;
+static CModifierCandidateCache candidateCache;
+static std::map<const CBlockIndex*, COldModifierEntry> mapOldModifiers;
+
+void ClearStakeModifierCache()
+{
+    LOCK(cs_modifierCache);
+    candidateCache = CModifierCandidateCache();
+    mapOldModifiers.clear();
+}
+
+static CModifierCandidate MakeCandidate(const CBlockIndex* pindex)
+{
+    CModifierCandidate candidate;
+    candidate.nTime = pindex->GetBlockTime();
+    candidate.hash = pindex->GetBlockHash();
+    candidate.pindex = pindex;
+    return candidate;
+}
+
 // Get selection interval section (in seconds)
 static int64_t GetStakeModifierSelectionIntervalSection(int nSection)
 {
@@ -28,7 +86,7 @@ static int64_t GetStakeModifierSelectionIntervalSection(int nSection)
 // already selected blocks in vSelectedBlocks, and with timestamp up to
 // nSelectionIntervalStop.
 static bool SelectBlockFromCandidates(
-    std::vector<std::pair<int64_t, uint256> >& vSortedByTimestamp,
+    const std::vector<CModifierCandidate>& vSortedByTimestamp,
     std::map<uint256, const CBlockIndex*>& mapSelectedBlocks,
     int64_t nSelectionIntervalStop,
     uint64_t nStakeModifierPrev,
@@ -39,11 +97,8 @@ static bool SelectBlockFromCandidates(
     bool fSelected = false;
     uint256 hashBest;
     *pindexSelected = (const CBlockIndex*)0;
-    for (const auto& item : vSortedByTimestamp) {
-        if (!mapBlockIndex.count(item.second))
-            return error("%s : failed to find block index for candidate block %s", __func__, item.second.ToString().c_str());
-
-        const CBlockIndex* pindex = mapBlockIndex[item.second];
+    for (const CModifierCandidate& item : vSortedByTimestamp) {
+        const CBlockIndex* pindex = item.pindex;
         if (fSelected && pindex->GetBlockTime() > nSelectionIntervalStop)
             break;
 
@@ -91,6 +146,16 @@ static bool SelectBlockFromCandidates(
 // modifier about a selection interval later than the coin generating the kernel
 bool GetOldModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier)
 {
+    // The walk below only depends on the active chain up to the block found
+    {
+        LOCK(cs_modifierCache);
+        std::map<const CBlockIndex*, COldModifierEntry>::const_iterator it = mapOldModifiers.find(pindexFrom);
+        if (it != mapOldModifiers.end() && chainActive.Contains(pindexFrom) && chainActive.Contains(it->second.pindexModifier)) {
+            nStakeModifier = it->second.nStakeModifier;
+            return true;
+        }
+    }
+
     int64_t nStakeModifierTime = pindexFrom->GetBlockTime();
     const CBlockIndex* pindex = pindexFrom;
     CBlockIndex* pindexNext = chainActive[pindex->nHeight + 1];
@@ -107,6 +172,13 @@ bool GetOldModifier(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier)
     } while (nStakeModifierTime < pindexFrom->GetBlockTime() + OLD_MODIFIER_INTERVAL);
 
     nStakeModifier = pindex->GetStakeModifierV1();
+
+    LOCK(cs_modifierCache);
+    if (mapOldModifiers.size() >= MAX_OLD_MODIFIER_ENTRIES)
+        mapOldModifiers.clear();
+    COldModifierEntry& entry = mapOldModifiers[pindexFrom];
+    entry.pindexModifier = pindex;
+    entry.nStakeModifier = nStakeModifier;
     return true;
 }
 
@@ -119,7 +191,7 @@ bool GetOldStakeModifier(CStakeInput* stake, uint64_t& nStakeModifier)
         const int nHeightStop = std::min(chainActive.Height(), Params().GetConsensus().height_last_ZC_AccumCheckpoint-1);
         while (pindexFrom && pindexFrom->nHeight + 1 <= nHeightStop) {
             if (pindexFrom->GetBlockTime() - nTimeBlockFrom > 60 * 60) {
-                nStakeModifier = pindexFrom->nAccumulatorCheckpoint.GetCheapHash();
+                nStakeModifier = pindexFrom->GetAccumulatorCheckpoint().GetCheapHash();
                 return true;
             }
             pindexFrom = chainActive.Next(pindexFrom);
@@ -177,20 +249,48 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
         return true;
 
     // Sort candidate blocks by timestamp
-    std::vector<std::pair<int64_t, uint256> > vSortedByTimestamp;
-    vSortedByTimestamp.reserve(64 * MODIFIER_INTERVAL  / Params().GetConsensus().nTargetSpacing);
+    std::vector<CModifierCandidate> vSortedByTimestamp;
     int64_t nSelectionIntervalStart = (pindexPrev->GetBlockTime() / MODIFIER_INTERVAL ) * MODIFIER_INTERVAL  - OLD_MODIFIER_INTERVAL;
     const CBlockIndex* pindex = pindexPrev;
-
-    while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
-        vSortedByTimestamp.push_back(std::make_pair(pindex->GetBlockTime(), pindex->GetBlockHash()));
-        pindex = pindex->pprev;
+    int nHeightFirstCandidate;
+    {
+        LOCK(cs_modifierCache);
+        CModifierCandidateCache& cache = candidateCache;
+        if (cache.pindexPrev && cache.pindexPrev == pindexPrev->pprev && nSelectionIntervalStart >= cache.nSelectionIntervalStart &&
+                pindexPrev->GetBlockTime() >= nSelectionIntervalStart) {
+            // Drop the candidates from the first one before the new start on
+            std::deque<const CBlockIndex*>::iterator it = cache.chain.begin();
+            while (it != cache.chain.end() && (*it)->GetBlockTime() >= nSelectionIntervalStart)
+                ++it;
+            for (std::deque<const CBlockIndex*>::iterator itDrop = it; itDrop != cache.chain.end(); ++itDrop) {
+                const CModifierCandidate candidate = MakeCandidate(*itDrop);
+                cache.vSortedByTimestamp.erase(std::lower_bound(cache.vSortedByTimestamp.begin(), cache.vSortedByTimestamp.end(), candidate));
+            }
+            const bool fTrimmed = it != cache.chain.end();
+            cache.chain.erase(it, cache.chain.end());
+            const CModifierCandidate candidate = MakeCandidate(pindexPrev);
+            cache.vSortedByTimestamp.insert(std::upper_bound(cache.vSortedByTimestamp.begin(), cache.vSortedByTimestamp.end(), candidate), candidate);
+            cache.chain.push_front(pindexPrev);
+            if (fTrimmed)
+                cache.nHeightFirstCandidate = cache.chain.back()->nHeight;
+        } else {
+            cache.chain.clear();
+            cache.vSortedByTimestamp.clear();
+            cache.vSortedByTimestamp.reserve(64 * MODIFIER_INTERVAL  / Params().GetConsensus().nTargetSpacing);
+            while (pindex && pindex->GetBlockTime() >= nSelectionIntervalStart) {
+                cache.chain.push_back(pindex);
+                cache.vSortedByTimestamp.push_back(MakeCandidate(pindex));
+                pindex = pindex->pprev;
+            }
+            cache.nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
+            std::sort(cache.vSortedByTimestamp.begin(), cache.vSortedByTimestamp.end());
+        }
+        cache.pindexPrev = pindexPrev;
+        cache.nSelectionIntervalStart = nSelectionIntervalStart;
+        vSortedByTimestamp = cache.vSortedByTimestamp;
+        nHeightFirstCandidate = cache.nHeightFirstCandidate;
     }
 
-    int nHeightFirstCandidate = pindex ? (pindex->nHeight + 1) : 0;
-    std::reverse(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-    std::sort(vSortedByTimestamp.begin(), vSortedByTimestamp.end());
-
     // Select 64 blocks from candidate blocks to generate stake modifier
     uint64_t nStakeModifierNew = 0;
     int64_t nSelectionIntervalStop = nSelectionIntervalStart;
@@ -14,5 +14,7 @@
 // Old Modifier - Only for IBD
 bool GetOldStakeModifier(CStakeInput* stake, uint64_t& nStakeModifier);
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
+// Forget the block index entries remembered by the two functions above
+void ClearStakeModifierCache();
 
 #endif // TARIAN_LEGACY_MODIFIER_H
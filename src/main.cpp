@@ -12,10 +12,12 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockfilter.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinstats.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/tx_verify.h"
@@ -24,6 +26,7 @@
 #include "fs.h"
 #include "init.h"
 #include "kernel.h"
+#include "legacy/stakemodifier.h"
 #include "masternode-budget.h"
 #include "masternode-payments.h"
 #include "masternodeman.h"
@@ -40,6 +43,7 @@
 #include "guiinterface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "ztarnchain.h"
 
@@ -78,6 +82,7 @@
 RecursiveMutex cs_main;
 
 BlockMap mapBlockIndex;
+CBlockIndexArena blockIndexArena;
 CChain chainActive;
 CBlockIndex* pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
@@ -92,6 +97,8 @@ int nScriptCheckThreads = 0;
 std::atomic<bool> fImporting{false};
 std::atomic<bool> fReindex{false};
 bool fTxIndex = true;
+bool fBlockFilterIndex = false;
+bool fCoinStatsIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -223,6 +230,9 @@ std::set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 std::set<int> setDirtyFileInfo;
+
+/** Whether the block tree has entries loaded from a UTXO snapshot (BLOCK_ASSUMED_VALID). Protected by cs_main. */
+bool fSnapshotChain = false;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -648,9 +658,12 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewDB* pcoinsdbview = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
 CSporkDB* pSporkDB = NULL;
+CBlockFilterDB* pblockfilterdb = NULL;
+CCoinStatsDB* pcoinstatsdb = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -830,8 +843,8 @@ std::string FormatStateMessage(const CValidationState &state)
         state.GetRejectCode());
 }
 
-bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree,
-        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectInsaneFee, bool ignoreFees)
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree,
+        bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit, bool fRejectInsaneFee, bool ignoreFees)
 {
     AssertLockHeld(cs_main);
     if (pfMissingInputs)
@@ -1001,7 +1014,7 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
         if (!hasZcSpendInputs)
             dPriority = view.GetPriority(tx, chainHeight, inChainInputValue);
 
-        CTxMemPoolEntry entry(tx, nFees, GetTime(), dPriority, chainHeight, pool.HasNoInputsOf(tx), inChainInputValue);
+        CTxMemPoolEntry entry(tx, nFees, nAcceptTime, dPriority, chainHeight, pool.HasNoInputsOf(tx), inChainInputValue);
         unsigned int nSize = entry.GetTxSize();
 
         // Don't accept it if it can't get into a block
@@ -1115,6 +1128,12 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
     return true;
 }
 
+bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree,
+        bool* pfMissingInputs, bool fOverrideMempoolLimit, bool fRejectInsaneFee, bool ignoreFees)
+{
+    return AcceptToMemoryPoolWithTime(pool, state, tx, fLimitFree, pfMissingInputs, GetTime(), fOverrideMempoolLimit, fRejectInsaneFee, ignoreFees);
+}
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee, bool isDSTX)
 {
     AssertLockHeld(cs_main);
@@ -1898,11 +1917,11 @@ void DataBaseAccChecksum(CBlockIndex* pindex, bool fWrite)
     if (!pindex ||
             !consensus.NetworkUpgradeActive(pindex->nHeight, Consensus::UPGRADE_ZC_V2) ||
             pindex->nHeight > consensus.height_last_ZC_AccumCheckpoint ||
-            pindex->nAccumulatorCheckpoint == pindex->pprev->nAccumulatorCheckpoint)
+            pindex->GetAccumulatorCheckpoint() == pindex->pprev->GetAccumulatorCheckpoint())
         return;
 
-    uint256 accCurr = pindex->nAccumulatorCheckpoint;
-    uint256 accPrev = pindex->pprev->nAccumulatorCheckpoint;
+    uint256 accCurr = pindex->GetAccumulatorCheckpoint();
+    uint256 accPrev = pindex->pprev->GetAccumulatorCheckpoint();
     // add/remove changed checksums to/from DB
     for (int i = (int)libzerocoin::zerocoinDenomList.size()-1; i >= 0; i--) {
         const uint32_t& nChecksum = accCurr.Get32();
@@ -2113,6 +2132,32 @@ bool FindUndoPos(CValidationState& state, int nFile, CDiskBlockPos& pos, unsigne
 
 static CCheckQueue<CScriptCheck> scriptcheckqueue(128);
 
+/** Build the basic compact filter of a connected block and add it to the filter index */
+static bool WriteBlockFilterToIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    uint256 prevFilterHash, prevFilterHeader;
+    if (pindex->pprev && !pblockfilterdb->ReadFilterHashAndHeader(BlockFilterType::BASIC, pindex->pprev->GetBlockHash(), prevFilterHash, prevFilterHeader))
+        return error("%s : missing filter header for block %s", __func__, pindex->pprev->GetBlockHash().GetHex());
+
+    BlockFilter filter(BlockFilterType::BASIC, block, blockundo);
+    return pblockfilterdb->WriteFilter(filter, filter.ComputeHeader(prevFilterHeader));
+}
+
+/** Derive the UTXO set statistics of a connected block from its parent's and add them to the index */
+static bool WriteCoinStatsToIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    CCoinStatsEntry entry;
+    if (pindex->pprev) {
+        if (!pcoinstatsdb->ReadStats(pindex->pprev->GetBlockHash(), entry))
+            return error("%s : missing coin stats for block %s", __func__, pindex->pprev->GetBlockHash().GetHex());
+        entry.ApplyBlock(block, blockundo, pindex->nHeight);
+    } else {
+        // The genesis coinbase never enters the UTXO set
+        entry.muhash.Finalize(entry.hashMuHash);
+    }
+    return pcoinstatsdb->WriteStats(pindex->GetBlockHash(), entry);
+}
+
 void ThreadScriptCheck()
 {
     util::ThreadRename("tarian-scriptch");
@@ -2150,8 +2195,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == consensus.hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (fBlockFilterIndex && pblockfilterdb && !WriteBlockFilterToIndex(block, CBlockUndo(), pindex))
+                return AbortNode(state, "Failed to write block filter index");
+            if (fCoinStatsIndex && pcoinstatsdb && !WriteCoinStatsToIndex(block, CBlockUndo(), pindex))
+                return AbortNode(state, "Failed to write coin stats index");
+        }
         return true;
     }
 
@@ -2409,6 +2459,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (fBlockFilterIndex && pblockfilterdb && !WriteBlockFilterToIndex(block, blockundo, pindex))
+        return AbortNode(state, "Failed to write block filter index");
+
+    if (fCoinStatsIndex && pcoinstatsdb && !WriteCoinStatsToIndex(block, blockundo, pindex))
+        return AbortNode(state, "Failed to write coin stats index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2552,7 +2608,8 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
             if (!CheckDiskSpace(128 * 2 * 2 * pcoinsTip->GetCacheSize()))
                 return state.Error("out of disk space");
             // Flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
+            // Unless it must be on disk now, the coin database writes it in the background.
+            if (!pcoinsTip->Flush() || (mode == FLUSH_STATE_ALWAYS && !pcoinsdbview->WaitFlushed()))
                 return AbortNode(state, "Failed to write to coin database");
             nLastFlush = nNow;
         }
@@ -3184,8 +3241,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3209,6 +3265,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
             pindexNew->SetNewStakeModifier(block.vtx[1].vin[0].prevout.hash);
         }
     }
+    pindexNew->BuildMedianTimePast();
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
     if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
@@ -4113,13 +4170,32 @@ const CBlockIndex* CBlockIndex::GetAncestor(int height) const
     return const_cast<CBlockIndex*>(this)->GetAncestor(height);
 }
 
+std::vector<const CBlockIndex*> CBlockIndex::GetAncestors(const std::vector<int>& vHeights) const
+{
+    std::vector<const CBlockIndex*> vAncestors(vHeights.size(), NULL);
+    std::vector<size_t> vOrder(vHeights.size());
+    for (size_t i = 0; i < vOrder.size(); i++)
+        vOrder[i] = i;
+    std::sort(vOrder.begin(), vOrder.end(), [&vHeights](size_t a, size_t b) { return vHeights[a] > vHeights[b]; });
+
+    // Each ancestor is found from the previous, higher one
+    const CBlockIndex* pindex = this;
+    for (size_t i : vOrder) {
+        if (vHeights[i] > nHeight || vHeights[i] < 0)
+            continue;
+        pindex = pindex->GetAncestor(vHeights[i]);
+        vAncestors[i] = pindex;
+    }
+    return vAncestors;
+}
+
 void CBlockIndex::BuildSkip()
 {
     if (pprev)
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
 
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const CBlock* pblock, CDiskBlockPos* dbp)
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const CBlock* pblock, CDiskBlockPos* dbp, bool fPrechecked)
 {
     AssertLockNotHeld(cs_main);
 
@@ -4127,9 +4203,9 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const CBlock* pblock
     int64_t nStartTime = GetTimeMillis();
 
     // check block
-    bool checked = CheckBlock(*pblock, state);
+    bool checked = CheckBlock(*pblock, state, true, !fPrechecked);
 
-    if (!CheckBlockSignature(*pblock))
+    if (!fPrechecked && !CheckBlockSignature(*pblock))
         return error("%s : bad proof-of-stake block signature", __func__);
 
     if (pblock->GetHash() != Params().GetConsensus().hashGenesisBlock && pfrom != NULL) {
@@ -4295,9 +4371,7 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw std::runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(std::make_pair(hash, pindexNew)).first;
 
     pindexNew->phashBlock = &((*mi).first);
@@ -4305,6 +4379,47 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
     return pindexNew;
 }
 
+/** Below this many entries sorting by height is not worth spreading over threads */
+static const size_t PARALLEL_HEIGHT_SORT_MIN = 100000;
+
+static void SortRangeByHeight(std::vector<std::pair<int, CBlockIndex*> >* pv, size_t nBegin, size_t nEnd)
+{
+    std::sort(pv->begin() + nBegin, pv->begin() + nEnd);
+}
+
+/** Sort block index entries by height, sorting chunks on separate threads and merging them pairwise */
+static void ParallelSortByHeight(std::vector<std::pair<int, CBlockIndex*> >& v)
+{
+    const size_t nThreads = std::max(1, GetNumCores());
+    if (nThreads == 1 || v.size() < PARALLEL_HEIGHT_SORT_MIN) {
+        std::sort(v.begin(), v.end());
+        return;
+    }
+
+    const size_t nChunk = (v.size() + nThreads - 1) / nThreads;
+    std::vector<size_t> vBounds;
+    for (size_t nBegin = 0; nBegin < v.size(); nBegin += nChunk)
+        vBounds.push_back(nBegin);
+    vBounds.push_back(v.size());
+
+    boost::thread_group threads;
+    for (size_t i = 0; i + 1 < vBounds.size(); i++)
+        threads.create_thread(boost::bind(&SortRangeByHeight, &v, vBounds[i], vBounds[i + 1]));
+    threads.join_all();
+
+    while (vBounds.size() > 2) {
+        std::vector<size_t> vMerged;
+        for (size_t i = 0; i + 2 < vBounds.size(); i += 2) {
+            std::inplace_merge(v.begin() + vBounds[i], v.begin() + vBounds[i + 1], v.begin() + vBounds[i + 2]);
+            vMerged.push_back(vBounds[i]);
+        }
+        if (vBounds.size() % 2 == 0)
+            vMerged.push_back(vBounds[vBounds.size() - 2]);
+        vMerged.push_back(v.size());
+        vBounds.swap(vMerged);
+    }
+}
+
 bool static LoadBlockIndexDB(std::string& strError)
 {
     if (!pblocktree->LoadBlockIndexGuts())
@@ -4319,14 +4434,17 @@ bool static LoadBlockIndexDB(std::string& strError)
         CBlockIndex* pindex = item.second;
         vSortedByHeight.push_back(std::make_pair(pindex->nHeight, pindex));
     }
-    std::sort(vSortedByHeight.begin(), vSortedByHeight.end());
+    ParallelSortByHeight(vSortedByHeight);
     for (const PAIRTYPE(int, CBlockIndex*) & item : vSortedByHeight) {
         // Stop if shutdown was requested
         if (ShutdownRequested()) return false;
 
         CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
-        if (pindex->nStatus & BLOCK_HAVE_DATA) {
+        // Entries of a UTXO snapshot count as connected, although their blocks were never downloaded
+        if (pindex->nStatus & BLOCK_ASSUMED_VALID)
+            fSnapshotChain = true;
+        if (pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_ASSUMED_VALID)) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -4344,6 +4462,7 @@ bool static LoadBlockIndexDB(std::string& strError)
             pindexBestInvalid = pindex;
         if (pindex->pprev)
             pindex->BuildSkip();
+        pindex->BuildMedianTimePast();
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
@@ -4386,6 +4505,14 @@ bool static LoadBlockIndexDB(std::string& strError)
     pblocktree->ReadFlag("shutdown", fLastShutdownWasPrepared);
     LogPrintf("%s: Last shutdown was prepared: %s\n", __func__, fLastShutdownWasPrepared);
 
+    // A UTXO snapshot that was not completely loaded leaves the databases unusable
+    bool fSnapshotLoading = false;
+    pblocktree->ReadFlag("snapshotloading", fSnapshotLoading);
+    if (fSnapshotLoading) {
+        strError = _("Loading a UTXO snapshot was interrupted, restart with -reindex to start over");
+        return false;
+    }
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -4395,6 +4522,14 @@ bool static LoadBlockIndexDB(std::string& strError)
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have a compact block filter index
+    pblocktree->ReadFlag("blockfilterindex", fBlockFilterIndex);
+    LogPrintf("LoadBlockIndexDB(): block filter index %s\n", fBlockFilterIndex ? "enabled" : "disabled");
+
+    // Check whether we have a UTXO set statistics index
+    pblocktree->ReadFlag("coinstatsindex", fCoinStatsIndex);
+    LogPrintf("LoadBlockIndexDB(): coin stats index %s\n", fCoinStatsIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -4415,85 +4550,349 @@ bool static LoadBlockIndexDB(std::string& strError)
     return true;
 }
 
-CVerifyDB::CVerifyDB()
+bool ActivateSnapshotChain(const std::vector<CBlockIndex*>& vChain, const CUTXOSnapshotInfo& info, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+
+    for (CBlockIndex* pindex : vChain) {
+        // The genesis block was connected already
+        if (!pindex->pprev)
+            continue;
+        pindex->nChainWork = pindex->pprev->nChainWork + GetBlockProof(*pindex);
+        pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
+        pindex->BuildSkip();
+        pindex->BuildMedianTimePast();
+        setDirtyBlockIndex.insert(pindex);
+    }
+    fSnapshotChain = true;
+
+    CBlockIndex* pindexBase = vChain.back();
+    chainActive.SetTip(pindexBase);
+    setBlockIndexCandidates.insert(pindexBase);
+    PruneBlockIndexCandidates();
+    if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexBase->nChainWork)
+        pindexBestHeader = pindexBase;
+    pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+
+    // The supplies came with the snapshot, the zerocoin one as a record of the zerocoin database
+    nMoneySupply = info.nMoneySupply;
+    zerocoinDB->ReadZCSupply(mapZerocoinSupply);
+
+    if (fCoinStatsIndex && pcoinstatsdb && !pcoinstatsdb->WriteStats(pindexBase->GetBlockHash(), info.stats)) {
+        strError = "failed to write to the coin stats index";
+        return false;
+    }
+
+    CValidationState state;
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS)) {
+        strError = "failed to flush the chainstate: " + FormatStateMessage(state);
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+/** A block of the active chain to verify, with what is needed to read it without cs_main */
+struct CVerifyDBBlock {
+    CBlockIndex* pindex;
+    int nHeight;
+    uint256 hash;
+    uint256 hashPrev;
+    CDiskBlockPos pos;
+    CDiskBlockPos posUndo;
+};
+
+/** A block read ahead of the VerifyDB checks */
+struct CReadAheadBlock {
+    CBlock block;
+    //! block read and of the expected hash
+    bool fRead;
+    //! merkle root verified
+    bool fPrechecked;
+    //! undo data read and checksummed, when asked for
+    bool fUndoValid;
+
+    CReadAheadBlock() : fRead(false), fPrechecked(false), fUndoValid(true) {}
+};
+
+/**
+ * Reads the blocks of a list on worker threads, in list order and at most
+ * nWindow blocks ahead of the consumer, verifying on the way what needs no
+ * chain context: the block hash, the merkle root and, for level 2, the undo
+ * data checksum.
+ */
+class CBlockReadAhead
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable condRead;
+    boost::condition_variable condConsumed;
+    const std::vector<CVerifyDBBlock>& vBlocks;
+    const bool fUndo;
+    const size_t nWindow;
+    size_t nNext;
+    size_t nConsumed;
+    bool fStop;
+    std::map<size_t, std::shared_ptr<CReadAheadBlock> > mapRead;
+    boost::thread_group threadGroup;
+
+    void ThreadRead()
+    {
+        while (true) {
+            size_t i;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && nNext < vBlocks.size() && nNext >= nConsumed + nWindow)
+                    condConsumed.wait(lock);
+                if (fStop || nNext >= vBlocks.size())
+                    return;
+                i = nNext++;
+            }
+
+            const CVerifyDBBlock& entry = vBlocks[i];
+            std::shared_ptr<CReadAheadBlock> pread = std::make_shared<CReadAheadBlock>();
+            pread->fRead = ReadBlockFromDisk(pread->block, entry.pos) && pread->block.GetHash() == entry.hash;
+            if (pread->fRead) {
+                bool fMutated;
+                pread->fPrechecked = BlockMerkleRoot(pread->block, &fMutated) == pread->block.hashMerkleRoot && !fMutated;
+            }
+            if (fUndo && !entry.posUndo.IsNull()) {
+                CBlockUndo undo;
+                pread->fUndoValid = undo.ReadFromDisk(entry.posUndo, entry.hashPrev);
+            }
+
+            boost::unique_lock<boost::mutex> lock(cs);
+            mapRead[i] = pread;
+            condRead.notify_all();
+        }
+    }
+
+public:
+    CBlockReadAhead(const std::vector<CVerifyDBBlock>& vBlocksIn, bool fUndoIn, int nThreads)
+        : vBlocks(vBlocksIn), fUndo(fUndoIn), nWindow(nThreads * VERIFYDB_READAHEAD_BLOCKS), nNext(0), nConsumed(0), fStop(false)
+    {
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "blockread",
+                                                  boost::function<void()>(boost::bind(&CBlockReadAhead::ThreadRead, this))));
+    }
+
+    ~CBlockReadAhead()
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+            condConsumed.notify_all();
+        }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+
+    /** Wait for block i of the list; blocks must be taken in list order */
+    std::shared_ptr<CReadAheadBlock> Get(size_t i)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!mapRead.count(i))
+            condRead.wait(lock);
+        std::shared_ptr<CReadAheadBlock> pread = mapRead[i];
+        mapRead.erase(i);
+        nConsumed = i + 1;
+        condConsumed.notify_all();
+        return pread;
+    }
+};
+
+RecursiveMutex cs_verifyDBStatus;
+CVerifyDBStatus verifyDBStatus;
+
+int GetVerifyDBThreads()
+{
+    return std::max(1, std::min(GetNumCores(), MAX_VERIFYDB_THREADS));
+}
+
+/** The blocks of the active chain from pindexFrom down to nHeightMin that have data, skipping the heights in [nSkipMin, nSkipMax] */
+std::vector<CVerifyDBBlock> GetVerifyDBBlocks(CBlockIndex* pindexFrom, int nHeightMin, int nSkipMin = 0, int nSkipMax = -1)
 {
-    uiInterface.ShowProgress(_("Verifying blocks..."), 0);
+    AssertLockHeld(cs_main);
+    std::vector<CVerifyDBBlock> vBlocks;
+    for (CBlockIndex* pindex = pindexFrom; pindex && pindex->pprev && pindex->nHeight >= nHeightMin; pindex = pindex->pprev) {
+        // Nothing to check below the base of a UTXO snapshot
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            break;
+        if (pindex->nHeight >= nSkipMin && pindex->nHeight <= nSkipMax)
+            continue;
+        CVerifyDBBlock entry;
+        entry.pindex = pindex;
+        entry.nHeight = pindex->nHeight;
+        entry.hash = pindex->GetBlockHash();
+        entry.hashPrev = pindex->pprev->GetBlockHash();
+        entry.pos = pindex->GetBlockPos();
+        entry.posUndo = pindex->GetUndoPos();
+        vBlocks.push_back(entry);
+    }
+    return vBlocks;
+}
+
+} // anon namespace
+
+CVerifyDBStatus GetVerifyDBStatus()
+{
+    LOCK(cs_verifyDBStatus);
+    return verifyDBStatus;
+}
+
+CVerifyDB::CVerifyDB(bool fBackgroundIn) : fBackground(fBackgroundIn)
+{
+    if (!fBackground)
+        uiInterface.ShowProgress(_("Verifying blocks..."), 0);
 }
 
 CVerifyDB::~CVerifyDB()
 {
-    uiInterface.ShowProgress("", 100);
+    if (!fBackground)
+        uiInterface.ShowProgress("", 100);
 }
 
-bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth)
+bool CVerifyDB::VerifyBlocks(int nCheckLevel, int nCheckDepth)
 {
-    LOCK(cs_main);
-    if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
+    std::vector<CVerifyDBBlock> vBlocks;
+    CVerifyDBProgress progress;
+    int nResumed = 0;
+    {
+        LOCK(cs_main);
+        const int chainHeight = chainActive.Height();
+
+        // Skip what an interrupted run on this chain verified already
+        int nSkipMin = 0, nSkipMax = -1;
+        CVerifyDBProgress saved;
+        if (pblocktree->ReadVerifyProgress(saved) && saved.nCheckLevel >= std::min(nCheckLevel, 2)) {
+            BlockMap::iterator mi = mapBlockIndex.find(saved.hashTip);
+            if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second)) {
+                nSkipMin = saved.nHeight;
+                nSkipMax = mi->second->nHeight;
+                nResumed = GetVerifyDBBlocks(mi->second, std::max(nSkipMin, chainHeight - nCheckDepth)).size();
+            }
+        }
+        vBlocks = GetVerifyDBBlocks(chainActive.Tip(), chainHeight - nCheckDepth, nSkipMin, nSkipMax);
+        progress.hashTip = chainActive.Tip()->GetBlockHash();
+        progress.nCheckLevel = std::min(nCheckLevel, 2);
+        progress.nHeight = chainHeight + 1;
+    }
+    const int nBlocks = vBlocks.size() + nResumed;
+    if (nResumed > 0)
+        LogPrintf("Resuming verification, %i of %i blocks verified by an earlier run\n", nResumed, nBlocks);
+    {
+        LOCK(cs_verifyDBStatus);
+        verifyDBStatus.nBlocks = nBlocks;
+        verifyDBStatus.nVerified = nResumed;
+        verifyDBStatus.nResumed = nResumed;
+    }
+
+    const int nThreads = GetVerifyDBThreads();
+    const int64_t nStart = GetTimeMillis();
+    CValidationState state;
+    CBlockReadAhead readAhead(vBlocks, nCheckLevel >= 2, nThreads);
+    for (size_t i = 0; i < vBlocks.size(); i++) {
+        boost::this_thread::interruption_point();
+        const CVerifyDBBlock& entry = vBlocks[i];
+        {
+            LOCK(cs_verifyDBStatus);
+            verifyDBStatus.nVerified = nResumed + i;
+            verifyDBStatus.nHeight = entry.nHeight;
+        }
+        if (!fBackground)
+            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)((double)(nResumed + i) / (double)nBlocks * (nCheckLevel >= 3 ? 50 : 100)))));
+
+        // check level 0: read from disk
+        std::shared_ptr<CReadAheadBlock> pread = readAhead.Get(i);
+        if (!pread->fRead)
+            return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, entry.nHeight, entry.hash.ToString());
+        // check level 1: verify block validity
+        if (nCheckLevel >= 1) {
+            LOCK(cs_main);
+            const bool fVerifyingBlocksPrev = fVerifyingBlocks;
+            fVerifyingBlocks = true;
+            const bool fValid = CheckBlock(pread->block, state, true, !pread->fPrechecked);
+            fVerifyingBlocks = fVerifyingBlocksPrev;
+            if (!fValid)
+                return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, entry.nHeight, entry.hash.ToString(), FormatStateMessage(state));
+        }
+        // check level 2: verify undo validity
+        if (nCheckLevel >= 2 && !pread->fUndoValid)
+            return error("%s: *** found bad undo data at %d, hash=%s\n", __func__, entry.nHeight, entry.hash.ToString());
+
+        progress.nHeight = entry.nHeight;
+        if (ShutdownRequested() || i % 1000 == 999)
+            pblocktree->WriteVerifyProgress(progress);
+        if (ShutdownRequested())
+            return true;
+    }
+    pblocktree->EraseVerifyProgress();
+    {
+        LOCK(cs_verifyDBStatus);
+        verifyDBStatus.nVerified = nBlocks;
+    }
+    LogPrintf("Verified %i blocks at level %i with %i reader threads in %dms\n", vBlocks.size(), std::min(nCheckLevel, 2), nThreads, GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CVerifyDB::VerifyCoins(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth)
+{
+    AssertLockHeld(cs_main);
+    if (nCheckLevel < 3)
         return true;
 
     const int chainHeight = chainActive.Height();
-    // Verify blocks in the best chain
-    if (nCheckDepth <= 0)
-        nCheckDepth = 1000000000; // suffices until the year 19000
-    if (nCheckDepth > chainHeight)
-        nCheckDepth = chainHeight;
-    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
-    LogPrintf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
+    const int nThreads = GetVerifyDBThreads();
     CCoinsViewCache coins(coinsview);
     CBlockIndex* pindexState = chainActive.Tip();
     CBlockIndex* pindexFailure = NULL;
     int nGoodTransactions = 0;
     CValidationState state;
-    for (CBlockIndex* pindex = chainActive.Tip(); pindex && pindex->pprev; pindex = pindex->pprev) {
-        boost::this_thread::interruption_point();
-        uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
-        if (pindex->nHeight < chainHeight - nCheckDepth)
-            break;
-        CBlock block;
-        // check level 0: read from disk
-        if (!ReadBlockFromDisk(block, pindex))
-            return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-        // check level 1: verify block validity
-        if (nCheckLevel >= 1 && !CheckBlock(block, state))
-            return error("%s: *** found bad block at %d, hash=%s (%s)\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString(), FormatStateMessage(state));
-        // check level 2: verify undo validity
-        if (nCheckLevel >= 2 && pindex) {
-            CBlockUndo undo;
-            CDiskBlockPos pos = pindex->GetUndoPos();
-            if (!pos.IsNull()) {
-                if (!undo.ReadFromDisk(pos, pindex->pprev->GetBlockHash()))
-                    return error("%s: *** found bad undo data at %d, hash=%s\n", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-            }
-        }
-        // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
+    {
+        const std::vector<CVerifyDBBlock> vBlocks = GetVerifyDBBlocks(chainActive.Tip(), chainHeight - nCheckDepth);
+        CBlockReadAhead readAhead(vBlocks, false, nThreads);
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            boost::this_thread::interruption_point();
+            CBlockIndex* pindex = vBlocks[i].pindex;
+            if (!fBackground)
+                uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 50 + (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * 25))));
+            // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
+            if ((coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) > nCoinCacheUsage)
+                break;
+            std::shared_ptr<CReadAheadBlock> pread = readAhead.Get(i);
+            if (!pread->fRead)
+                return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
             bool fClean = true;
-            if (!DisconnectBlock(block, state, pindex, coins, &fClean))
+            if (!DisconnectBlock(pread->block, state, pindex, coins, &fClean))
                 return error("%s: *** irrecoverable inconsistency in block data at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
             pindexState = pindex->pprev;
             if (!fClean) {
                 nGoodTransactions = 0;
                 pindexFailure = pindex;
             } else
-                nGoodTransactions += block.vtx.size();
+                nGoodTransactions += pread->block.vtx.size();
+            if (ShutdownRequested())
+                return true;
         }
-        if (ShutdownRequested())
-            return true;
     }
     if (pindexFailure)
         return error("%s: *** coin database inconsistencies found (last %i blocks, %i good transactions before that)\n", __func__, chainHeight - pindexFailure->nHeight + 1, nGoodTransactions);
 
     // check level 4: try reconnecting blocks
-    if (nCheckLevel >= 4) {
-        CBlockIndex* pindex = pindexState;
-        while (pindex != chainActive.Tip()) {
+    if (nCheckLevel >= 4 && pindexState != chainActive.Tip()) {
+        std::vector<CVerifyDBBlock> vBlocks = GetVerifyDBBlocks(chainActive.Tip(), pindexState->nHeight + 1);
+        std::reverse(vBlocks.begin(), vBlocks.end());
+        CBlockReadAhead readAhead(vBlocks, false, nThreads);
+        for (size_t i = 0; i < vBlocks.size(); i++) {
             boost::this_thread::interruption_point();
-            uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * 50))));
-            pindex = chainActive.Next(pindex);
-            CBlock block;
-            if (!ReadBlockFromDisk(block, pindex))
+            CBlockIndex* pindex = vBlocks[i].pindex;
+            if (!fBackground)
+                uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, 100 - (int)(((double)(chainHeight - pindex->nHeight)) / (double)nCheckDepth * 25))));
+            std::shared_ptr<CReadAheadBlock> pread = readAhead.Get(i);
+            if (!pread->fRead)
                 return error("%s: *** ReadBlockFromDisk failed at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
-            if (!ConnectBlock(block, state, pindex, coins, false))
+            if (!ConnectBlock(pread->block, state, pindex, coins, false))
                 return error("%s: *** found unconnectable block at %d, hash=%s", __func__, pindex->nHeight, pindex->GetBlockHash().ToString());
         }
     }
@@ -4503,6 +4902,75 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
     return true;
 }
 
+bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth)
+{
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip() == NULL || chainActive.Tip()->pprev == NULL)
+            return true;
+
+        // Verify blocks in the best chain
+        if (nCheckDepth <= 0)
+            nCheckDepth = 1000000000; // suffices until the year 19000
+        if (nCheckDepth > chainActive.Height())
+            nCheckDepth = chainActive.Height();
+    }
+    nCheckLevel = std::max(0, std::min(4, nCheckLevel));
+    LogPrintf("Verifying last %i blocks at level %i%s\n", nCheckDepth, nCheckLevel, fBackground ? " in the background" : "");
+    {
+        LOCK(cs_verifyDBStatus);
+        verifyDBStatus = CVerifyDBStatus();
+        verifyDBStatus.strState = "running";
+        verifyDBStatus.fBackground = fBackground;
+        verifyDBStatus.nCheckLevel = nCheckLevel;
+        verifyDBStatus.nStartTime = GetTime();
+    }
+
+    bool fVerified;
+    try {
+        if (!fBackground) {
+            LOCK(cs_main);
+            fVerified = VerifyBlocks(nCheckLevel, nCheckDepth) && (ShutdownRequested() || VerifyCoins(coinsview, nCheckLevel, nCheckDepth));
+        } else {
+            // The coins checks need a chain state that stays put, those of
+            // the blocks only take cs_main for CheckBlock
+            fVerified = VerifyBlocks(nCheckLevel, nCheckDepth);
+            if (fVerified && !ShutdownRequested()) {
+                LOCK(cs_main);
+                const bool fVerifyingBlocksPrev = fVerifyingBlocks;
+                fVerifyingBlocks = true;
+                try {
+                    fVerified = VerifyCoins(coinsview, nCheckLevel, nCheckDepth);
+                } catch (...) {
+                    fVerifyingBlocks = fVerifyingBlocksPrev;
+                    throw;
+                }
+                fVerifyingBlocks = fVerifyingBlocksPrev;
+            }
+        }
+    } catch (...) {
+        LOCK(cs_verifyDBStatus);
+        verifyDBStatus.strState = "interrupted";
+        verifyDBStatus.nEndTime = GetTime();
+        throw;
+    }
+
+    LOCK(cs_verifyDBStatus);
+    verifyDBStatus.strState = !fVerified ? "failed" : ShutdownRequested() ? "interrupted" : "done";
+    verifyDBStatus.nEndTime = GetTime();
+    return fVerified;
+}
+
+void ThreadVerifyDB(int nCheckDepth)
+{
+    // Zerocoin must check at level 4
+    if (!CVerifyDB(true).VerifyDB(pcoinsTip, 4, nCheckDepth)) {
+        strMiscWarning = _("Warning: Corrupted block database detected, see debug.log. Restart with -reindex to rebuild it.");
+        LogPrintf("*** %s\n", strMiscWarning);
+        AlertNotify(strMiscWarning, true);
+    }
+}
+
 void UnloadBlockIndex()
 {
     LOCK(cs_main);
@@ -4524,13 +4992,13 @@ void UnloadBlockIndex()
     nPreferredDownload = 0;
     setDirtyBlockIndex.clear();
     setDirtyFileInfo.clear();
+    fSnapshotChain = false;
     mapNodeState.clear();
     recentRejects.reset(nullptr);
 
-    for (BlockMap::value_type& entry : mapBlockIndex) {
-        delete entry.second;
-    }
+    ClearStakeModifierCache();
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
 }
 
 bool LoadBlockIndex(std::string& strError)
@@ -4556,6 +5024,12 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    // Use the provided setting for -blockfilterindex in the new database
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX);
+    pblocktree->WriteFlag("blockfilterindex", fBlockFilterIndex);
+    // Use the provided setting for -coinstatsindex in the new database
+    fCoinStatsIndex = GetBoolArg("-coinstatsindex", DEFAULT_COINSTATSINDEX);
+    pblocktree->WriteFlag("coinstatsindex", fCoinStatsIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4584,104 +5058,341 @@ bool InitBlockIndex()
 }
 
 
+/** Disk positions of blocks with unknown parent, by the hash of the parent (only used for reindex) */
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/**
+ * Process a block read from a block file, or keep its position for when its
+ * parent shows up, then process the successors that were waiting for it.
+ * Returns false if processing hit an error that should end the import.
+ */
+static bool ImportBlock(const CBlock& block, const uint256& hash, CDiskBlockPos* dbp, bool fPrechecked, int& nLoaded)
+{
+    // detect out of order blocks, and store them for later
+    if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
+                hash.GetHex(), block.hashPrevBlock.GetHex());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
+
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        CValidationState state;
+        if (ProcessNewBlock(state, NULL, &block, dbp, fPrechecked))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
+
+    // Recursively process earlier encountered successors of this block
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            CBlock blockChild;
+            if (ReadBlockFromDisk(blockChild, it->second)) {
+                LogPrintf("%s: Processing out of order child %s of %s\n", __func__, blockChild.GetHash().ToString(),
+                    head.ToString());
+                CValidationState dummy;
+                if (ProcessNewBlock(dummy, NULL, &blockChild, &it->second)) {
+                    nLoaded++;
+                    queue.push_back(blockChild.GetHash());
+                }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+        }
+    }
+    return true;
+}
+
+/**
+ * Scan a block file for blocks, calling fn(block, pos) for each one found.
+ * Garbage between blocks is skipped; the scan ends at the first incomplete
+ * block header.
+ */
+template <typename Fn>
+static void ScanBlockFile(FILE* fileIn, int nFile, Fn fn)
+{
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        boost::this_thread::interruption_point();
+
+        blkdat.SetPos(nRewind);
+        nRewind++;         // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(Params().MessageStart()[0]);
+            nRewind = blkdat.GetPos() + 1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+            blkdat >> *pblock;
+            nRewind = blkdat.GetPos();
+            if (!fn(pblock, CDiskBlockPos(nFile, nBlockPos), nSize))
+                break;
+        } catch (const boost::thread_interrupted&) {
+            throw;
+        } catch (const std::exception& e) {
+            LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+}
+
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 {
-    // Map of disk positions for blocks with unknown parent (only used for reindex)
-    static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
     int64_t nStart = GetTimeMillis();
 
     int nLoaded = 0;
     try {
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2 * MAX_BLOCK_SIZE_CURRENT, MAX_BLOCK_SIZE_CURRENT + 8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+        ScanBlockFile(fileIn, dbp ? dbp->nFile : 0, [&](const std::shared_ptr<CBlock>& pblock, CDiskBlockPos pos, unsigned int nSize) {
+            if (dbp)
+                dbp->nPos = pos.nPos;
+            return ImportBlock(*pblock, pblock->GetHash(), dbp, false, nLoaded);
+        });
+    } catch (const std::runtime_error& e) {
+        AbortNode(std::string("System error: ") + e.what());
+    }
+    if (nLoaded > 0)
+        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+    return nLoaded > 0;
+}
 
-            blkdat.SetPos(nRewind);
-            nRewind++;         // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(Params().MessageStart()[0]);
-                nRewind = blkdat.GetPos() + 1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, Params().MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > MAX_BLOCK_SIZE_CURRENT)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
+namespace {
+
+/** A block read ahead of the connector by a reindex reader thread */
+struct CStagedBlock {
+    std::shared_ptr<CBlock> pblock;
+    uint256 hash;
+    CDiskBlockPos pos;
+    unsigned int nSize;
+    //! merkle root and block signature verified
+    bool fPrechecked;
+};
+
+/** Blocks of one block file, on their way from the thread scanning it to the connector */
+struct CStagedFile {
+    std::deque<CStagedBlock> queue;
+    size_t nBytes;
+    bool fDone;
+
+    CStagedFile() : nBytes(0), fDone(false) {}
+};
+
+/**
+ * Reindex pipeline: reader threads each take the next block file, locate and
+ * deserialize its blocks, hash them and verify the parts of CheckBlock that
+ * need no chain context (merkle root and block signature). The connector
+ * hands them to ProcessNewBlock in file order, as a sequential scan would.
+ * Readers stay within a window of files ahead of the connector, and stop
+ * staging blocks of a file once it holds REINDEX_STAGED_BYTES.
+ */
+class CReindexPipeline
+{
+private:
+    boost::mutex cs;
+    boost::condition_variable condStaged;
+    boost::condition_variable condConsumed;
+    std::map<int, CStagedFile> mapStaged;
+    int nNextFile;
+    int nConnectFile;
+    int nEndFile;
+    bool fStop;
+    const int nWindow;
+
+    // Per-stage throughput
+    std::atomic<uint64_t> nReadBytes;
+    std::atomic<uint64_t> nReadBlocks;
+    std::atomic<int64_t> nReadMicros;
+    std::atomic<int64_t> nPrecheckMicros;
+    int64_t nConnectMicros;
+    int64_t nWaitMicros;
+    int nConnected;
+
+    void ThreadRead()
+    {
+        while (true) {
+            int nFile;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (!fStop && nNextFile < nEndFile && nNextFile >= nConnectFile + nWindow)
+                    condConsumed.wait(lock);
+                if (fStop || nNextFile >= nEndFile)
+                    return;
+                nFile = nNextFile++;
             }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint(BCLog::REINDEX, "%s: Out of order block %s, parent %s not known\n", __func__,
-                            hash.GetHex(), block.hashPrevBlock.GetHex());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
+
+            CDiskBlockPos pos(nFile, 0);
+            FILE* file = fs::exists(GetBlockPosFilename(pos, "blk")) ? OpenBlockFile(pos, true) : NULL;
+            if (!file) {
+                // No block files left to reindex
+                boost::unique_lock<boost::mutex> lock(cs);
+                nEndFile = std::min(nEndFile, nFile);
+                mapStaged[nFile].fDone = true;
+                condStaged.notify_all();
+                condConsumed.notify_all();
+                continue;
+            }
+
+            int64_t nTimeRead = GetTimeMicros();
+            ScanBlockFile(file, nFile, [&](const std::shared_ptr<CBlock>& pblock, CDiskBlockPos posBlock, unsigned int nSize) {
+                int64_t nTimeCheck = GetTimeMicros();
+                nReadMicros += nTimeCheck - nTimeRead;
+                nReadBytes += nSize;
+                nReadBlocks++;
+
+                CStagedBlock staged;
+                staged.pblock = pblock;
+                staged.hash = pblock->GetHash();
+                staged.pos = posBlock;
+                staged.nSize = nSize;
+                bool fMutated;
+                staged.fPrechecked = BlockMerkleRoot(*pblock, &fMutated) == pblock->hashMerkleRoot && !fMutated &&
+                                     (pblock->IsProofOfWork() || (pblock->vtx.size() > 1 && pblock->vtx[1].IsCoinStake())) &&
+                                     CheckBlockSignature(*pblock);
+                nPrecheckMicros += GetTimeMicros() - nTimeCheck;
+
+                {
+                    boost::unique_lock<boost::mutex> lock(cs);
+                    CStagedFile& stagedFile = mapStaged[nFile];
+                    while (!fStop && stagedFile.nBytes >= REINDEX_STAGED_BYTES)
+                        condConsumed.wait(lock);
+                    if (fStop)
+                        return false;
+                    stagedFile.queue.push_back(staged);
+                    stagedFile.nBytes += nSize;
+                    condStaged.notify_all();
                 }
+                nTimeRead = GetTimeMicros();
+                return true;
+            });
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    CValidationState state;
-                    if (ProcessNewBlock(state, NULL, &block, dbp))
-                        nLoaded++;
-                    if (state.IsError())
+            boost::unique_lock<boost::mutex> lock(cs);
+            mapStaged[nFile].fDone = true;
+            condStaged.notify_all();
+        }
+    }
+
+    void Stop(boost::thread_group& threadGroup)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fStop = true;
+            condConsumed.notify_all();
+        }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+    }
+
+    void LogProgress(int64_t nStart)
+    {
+        const double dSeconds = std::max<int64_t>(GetTimeMicros() - nStart, 1) * 0.000001;
+        LogPrintf("Reindex: block file %d, height %d, read %.1fMB (%.1fMB/s per reader), prechecked %.0f blocks/s per reader, connected %d blocks (%.0f/s, %.1fs waiting for readers)\n",
+            nConnectFile, chainActive.Height(), nReadBytes * (1.0 / 1048576),
+            nReadBytes * (1.0 / 1048576) / std::max<int64_t>(nReadMicros, 1) * 1000000,
+            nReadBlocks * 1000000.0 / std::max<int64_t>(nPrecheckMicros, 1),
+            nConnected, nConnected / dSeconds, nWaitMicros * 0.000001);
+    }
+
+public:
+    CReindexPipeline(int nReaders) : nNextFile(0), nConnectFile(0), nEndFile(std::numeric_limits<int>::max()), fStop(false), nWindow(nReaders + 1),
+                                     nReadBytes(0), nReadBlocks(0), nReadMicros(0), nPrecheckMicros(0), nConnectMicros(0), nWaitMicros(0), nConnected(0) {}
+
+    void Run(int nReaders)
+    {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nReaders; i++)
+            threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "reindex",
+                                                  boost::function<void()>(boost::bind(&CReindexPipeline::ThreadRead, this))));
+
+        const int64_t nStart = GetTimeMicros();
+        int64_t nLastLog = nStart;
+        int nLoggedFile = -1;
+        try {
+            while (true) {
+                boost::this_thread::interruption_point();
+                CStagedBlock staged;
+                {
+                    int64_t nTimeWait = GetTimeMicros();
+                    boost::unique_lock<boost::mutex> lock(cs);
+                    if (nConnectFile >= nEndFile)
                         break;
-                } else if (hash != Params().GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrintf("Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+                    CStagedFile* pstagedFile = &mapStaged[nConnectFile];
+                    while (pstagedFile->queue.empty() && !pstagedFile->fDone)
+                        condStaged.wait(lock);
+                    nWaitMicros += GetTimeMicros() - nTimeWait;
+                    if (pstagedFile->queue.empty()) {
+                        mapStaged.erase(nConnectFile++);
+                        condConsumed.notify_all();
+                        continue;
+                    }
+                    staged = pstagedFile->queue.front();
+                    pstagedFile->queue.pop_front();
+                    pstagedFile->nBytes -= staged.nSize;
+                    condConsumed.notify_all();
+                }
+                if (staged.pos.nFile != nLoggedFile) {
+                    nLoggedFile = staged.pos.nFile;
+                    LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nLoggedFile);
                 }
 
-                // Recursively process earlier encountered successors of this block
-                std::deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second)) {
-                            LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                head.ToString());
-                            CValidationState dummy;
-                            if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                    }
+                int64_t nTimeConnect = GetTimeMicros();
+                if (!ImportBlock(*staged.pblock, staged.hash, &staged.pos, staged.fPrechecked, nConnected))
+                    break;
+                nConnectMicros += GetTimeMicros() - nTimeConnect;
+
+                if (GetTimeMicros() - nLastLog > 10 * 1000000) {
+                    LogProgress(nStart);
+                    nLastLog = GetTimeMicros();
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
             }
+        } catch (...) {
+            Stop(threadGroup);
+            throw;
         }
+        Stop(threadGroup);
+        LogProgress(nStart);
+    }
+};
+
+} // anon namespace
+
+void ReindexBlockFiles(int nReaders)
+{
+    int64_t nStart = GetTimeMillis();
+    try {
+        CReindexPipeline(nReaders).Run(nReaders);
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
     }
-    if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
-    return nLoaded > 0;
+    LogPrintf("Reindexed block files with %d reader threads in %dms\n", nReaders, GetTimeMillis() - nStart);
 }
 
 void static CheckBlockIndex()
@@ -4692,6 +5403,11 @@ void static CheckBlockIndex()
 
     LOCK(cs_main);
 
+    // The checks below assume that every block of the active chain was
+    // downloaded, which does not hold for the history of a UTXO snapshot.
+    if (fSnapshotChain)
+        return;
+
     // During a reindex, we read the genesis block and call CheckBlockIndex before ActivateBestChain,
     // so we have the genesis block in mapBlockIndex but no active chain.  (A few of the tests when
     // iterating the block tree require that chainActive has been initialized.)
@@ -5158,6 +5874,53 @@ void static ProcessGetData(CNode* pfrom)
 }
 
 bool fRequestedSporksIDB = false;
+/**
+ * Validate a getcfilters/getcfheaders request and collect the hashes of the
+ * requested blocks, from nStartHeight up to and including the stop block.
+ * Peers sending malformed requests, or requests to a node that doesn't
+ * serve compact filters, are disconnected.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight,
+                                      const uint256& stopHash, uint32_t nMaxHeightRange,
+                                      std::vector<uint256>& vBlockHashes)
+{
+    if (!(nLocalServices & NODE_COMPACT_FILTERS) || nFilterType != BlockFilterType::BASIC) {
+        LogPrint(BCLog::NET, "peer %d requested unsupported block filter type: %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(stopHash);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second)) {
+        LogPrint(BCLog::NET, "peer %d requested filters for unknown or inactive block: %s\n", pfrom->id, stopHash.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    const CBlockIndex* pindexStop = mi->second;
+    uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight) {
+        LogPrint(BCLog::NET, "peer %d sent invalid getcfilters/getcfheaders with start height %d and stop height %d\n",
+                 pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (nStopHeight - nStartHeight >= nMaxHeightRange) {
+        LogPrint(BCLog::NET, "peer %d requested too many cfilters/cfheaders: %d / %d\n",
+                 pfrom->id, nStopHeight - nStartHeight + 1, nMaxHeightRange);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    vBlockHashes.resize(nStopHeight - nStartHeight + 1);
+    for (const CBlockIndex* pindex = pindexStop; pindex && (uint32_t)pindex->nHeight >= nStartHeight; pindex = pindex->pprev) {
+        vBlockHashes[pindex->nHeight - nStartHeight] = pindex->GetBlockHash();
+        if (pindex->nHeight == 0) break;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     LogPrint(BCLog::NET, "received: %s (%u bytes) peer=%d\n", SanitizeString(strCommand), vRecv.size(), pfrom->id);
@@ -5563,6 +6326,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         CValidationState state;
 
         mapAlreadyAskedFor.erase(inv);
+        pfrom->MarkGetDataReceived(inv);
 
         if (!tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
             mempool.check(pcoinsTip);
@@ -5786,6 +6550,18 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
+    else if (strCommand == NetMsgType::NOTFOUND) {
+        // The peer doesn't have what we asked for, so don't wait for its request to time out
+        std::vector<CInv> vInv;
+        vRecv >> vInv;
+        if (vInv.size() <= MAX_INV_SZ) {
+            LOCK(cs_main);
+            for (const CInv& inv : vInv)
+                pfrom->MarkGetDataReceived(inv);
+        }
+    }
+
+
     else if (strCommand == NetMsgType::MEMPOOL) {
         LOCK2(cs_main, pfrom->cs_filter);
 
@@ -5942,6 +6718,66 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS) {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        std::vector<uint256> vBlockHashes;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFILTERS_SIZE, vBlockHashes))
+            return true;
+
+        // Filters are served straight from the index, no block data is read
+        for (const uint256& hash : vBlockHashes) {
+            BlockFilter filter;
+            if (!pblockfilterdb->ReadFilter(BlockFilterType::BASIC, hash, filter)) {
+                LogPrint(BCLog::NET, "%s: failed to find block filter for block %s\n", __func__, hash.ToString());
+                return true;
+            }
+            pfrom->PushMessage(NetMsgType::CFILTER, filter);
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS) {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        std::vector<uint256> vBlockHashes;
+        if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFHEADERS_SIZE, vBlockHashes))
+            return true;
+
+        uint256 prevFilterHeader;
+        if (nStartHeight > 0) {
+            uint256 prevHash, prevFilterHash;
+            {
+                LOCK(cs_main);
+                prevHash = chainActive[nStartHeight - 1]->GetBlockHash();
+            }
+            if (!pblockfilterdb->ReadFilterHashAndHeader(BlockFilterType::BASIC, prevHash, prevFilterHash, prevFilterHeader)) {
+                LogPrint(BCLog::NET, "%s: failed to find block filter header for block %s\n", __func__, prevHash.ToString());
+                return true;
+            }
+        }
+
+        std::vector<uint256> vFilterHashes;
+        vFilterHashes.reserve(vBlockHashes.size());
+        for (const uint256& hash : vBlockHashes) {
+            uint256 filterHash, filterHeader;
+            if (!pblockfilterdb->ReadFilterHashAndHeader(BlockFilterType::BASIC, hash, filterHash, filterHeader)) {
+                LogPrint(BCLog::NET, "%s: failed to find block filter hashes for block %s\n", __func__, hash.ToString());
+                return true;
+            }
+            vFilterHashes.push_back(filterHash);
+        }
+
+        pfrom->PushMessage(NetMsgType::CFHEADERS, nFilterType, stopHash, prevFilterHeader, vFilterHashes);
+    }
+
+
     else if (strCommand == NetMsgType::REJECT) {
       std::string strMsg;
       unsigned char ccode;
@@ -6233,7 +7069,6 @@ bool SendMessages(CNode* pto)
         // Message: inventory
         //
         std::vector<CInv> vInv;
-        std::vector<CInv> vInvWait;
         {
             bool fSendTrickle = pto->fWhitelisted;
             if (pto->nNextInvSend < nNow) {
@@ -6241,11 +7076,15 @@ bool SendMessages(CNode* pto)
                 pto->nNextInvSend = PoissonNextSend(nNow, AVG_INVENTORY_BROADCAST_INTERVAL);
             }
             LOCK(pto->cs_inventory);
-            vInv.reserve(pto->vInventoryToSend.size());
-            vInvWait.reserve(pto->vInventoryToSend.size());
+            std::vector<CInv> vInvWait;
+            vInv.reserve(std::min<size_t>(pto->vInventoryToSend.size(), MAX_INV_SEND_BATCH));
             for (const CInv& inv : pto->vInventoryToSend) {
-                if (inv.type == MSG_TX && pto->filterInventoryKnown.contains(inv.hash))
+                // Skip anything the peer announced to us or we already announced to it,
+                // which also drops duplicates queued since the last batch
+                if (inv.type != MSG_BLOCK && pto->filterInventoryKnown.contains(inv.hash)) {
+                    pto->nInvKnownSkipped++;
                     continue;
+                }
 
                 // trickle out tx inv to protect privacy
                 if (inv.type == MSG_TX && !fSendTrickle) {
@@ -6266,15 +7105,18 @@ bool SendMessages(CNode* pto)
                 pto->filterInventoryKnown.insert(inv.hash);
 
                 vInv.push_back(inv);
-                if (vInv.size() >= 1000) {
+                if (vInv.size() >= MAX_INV_SEND_BATCH) {
+                    pto->nInvSent += vInv.size();
                     pto->PushMessage(NetMsgType::INV, vInv);
                     vInv.clear();
                 }
             }
-            pto->vInventoryToSend = vInvWait;
+            pto->vInventoryToSend.swap(vInvWait);
         }
-        if (!vInv.empty())
+        if (!vInv.empty()) {
+            pto->nInvSent += vInv.size();
             pto->PushMessage(NetMsgType::INV, vInv);
+        }
 
         // Detect whether we're stalling
         nNow = GetTimeMicros();
@@ -6317,20 +7159,38 @@ bool SendMessages(CNode* pto)
             }
         }
 
+        //
+        // Expire non-block getdata requests the peer never answered
+        //
+        while (!pto->vGetDataExpiration.empty() && pto->vGetDataExpiration.front().first <= nNow) {
+            const std::pair<int64_t, CInv>& entry = pto->vGetDataExpiration.front();
+            std::map<CInv, int64_t>::iterator it = pto->mapGetDataInFlight.find(entry.second);
+            // Entries superseded by a newer request for the same item are just dropped
+            if (it != pto->mapGetDataInFlight.end() && it->second == entry.first) {
+                if (!AlreadyHave(entry.second)) {
+                    LogPrint(BCLog::NET, "getdata request for %s timed out peer=%d\n", entry.second.ToString(), pto->id);
+                    pto->nGetDataTimeouts++;
+                }
+                pto->mapGetDataInFlight.erase(it);
+            }
+            pto->vGetDataExpiration.pop_front();
+        }
+
         //
         // Message: getdata (non-blocks)
         //
-        while (!pto->fDisconnect && !pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow) {
-            const CInv& inv = (*pto->mapAskFor.begin()).second;
-            if (!AlreadyHave(inv)) {
+        while (!pto->fDisconnect && !pto->queueAskFor.empty() && pto->queueAskFor.top().first <= nNow) {
+            const CInv inv = pto->queueAskFor.top().second;
+            pto->queueAskFor.pop();
+            if (!AlreadyHave(inv) && !pto->mapGetDataInFlight.count(inv)) {
                 LogPrint(BCLog::NET, "Requesting %s peer=%d\n", inv.ToString(), pto->id);
                 vGetData.push_back(inv);
+                pto->MarkGetDataSent(inv, nNow);
                 if (vGetData.size() >= 1000) {
                     pto->PushMessage(NetMsgType::GETDATA, vGetData);
                     vGetData.clear();
                 }
             }
-            pto->mapAskFor.erase(pto->mapAskFor.begin());
         }
         if (!vGetData.empty())
             pto->PushMessage(NetMsgType::GETDATA, vGetData);
@@ -6397,6 +7257,155 @@ std::string CBlockFileInfo::ToString() const
     return strprintf("CBlockFileInfo(blocks=%u, size=%u, heights=%u...%u, time=%s...%s)", nBlocks, nSize, nHeightFirst, nHeightLast, DateTimeStrFormat("%Y-%m-%d", nTimeFirst), DateTimeStrFormat("%Y-%m-%d", nTimeLast));
 }
 
+static const uint64_t MEMPOOL_DUMP_VERSION = 1;
+
+bool DumpMempool()
+{
+    int64_t nStart = GetTimeMicros();
+
+    std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+    std::vector<std::pair<CTransaction, int64_t> > vEntries;
+    {
+        LOCK(mempool.cs);
+        mapDeltas = mempool.mapDeltas;
+        vEntries.reserve(mempool.mapTx.size());
+        for (const CTxMemPoolEntry& entry : mempool.mapTx)
+            vEntries.push_back(std::make_pair(entry.GetTx(), entry.GetTime()));
+    }
+
+    int64_t nMid = GetTimeMicros();
+
+    // serialize deltas and transactions, checksum data up to that point, then append csum
+    CDataStream ssMempool(SER_DISK, CLIENT_VERSION);
+    ssMempool << MEMPOOL_DUMP_VERSION;
+    ssMempool << mapDeltas;
+    ssMempool << (uint64_t)vEntries.size();
+    for (const std::pair<CTransaction, int64_t>& entry : vEntries)
+        ssMempool << entry.first << entry.second;
+    uint256 hash = Hash(ssMempool.begin(), ssMempool.end());
+    ssMempool << hash;
+
+    // write to a temporary file first, so a crash never leaves a truncated mempool.dat behind
+    fs::path pathTmp = GetDataDir() / "mempool.dat.new";
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull())
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
+
+    try {
+        fileout << ssMempool;
+    } catch (const std::exception& e) {
+        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, GetDataDir() / "mempool.dat"))
+        return error("%s : Rename-into-place failed", __func__);
+
+    int64_t nLast = GetTimeMicros();
+    LogPrintf("Dumped mempool: %u transactions, %gs to copy, %gs to dump\n",
+              vEntries.size(), (nMid - nStart) * 0.000001, (nLast - nMid) * 0.000001);
+    return true;
+}
+
+bool LoadMempool(CTxMemPool& pool)
+{
+    const int64_t nExpiryTimeout = GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
+
+    fs::path pathMempool = GetDataDir() / "mempool.dat";
+    FILE* file = fsbridge::fopen(pathMempool, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        LogPrintf("Failed to open mempool file from disk. Continuing anyway.\n");
+        return false;
+    }
+
+    uint64_t fileSize = fs::file_size(pathMempool);
+    if (fileSize < sizeof(uint256))
+        return error("%s : mempool file %s is too small", __func__, pathMempool.string());
+    std::vector<unsigned char> vchData(fileSize - sizeof(uint256));
+    uint256 hashIn;
+
+    // read data and checksum from file
+    try {
+        filein.read((char*)vchData.data(), vchData.size());
+        filein >> hashIn;
+    } catch (const std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+    filein.fclose();
+
+    CDataStream ssMempool(vchData, SER_DISK, CLIENT_VERSION);
+
+    // verify stored checksum matches input data
+    if (hashIn != Hash(ssMempool.begin(), ssMempool.end()))
+        return error("%s : Checksum mismatch, data corrupted", __func__);
+
+    int64_t nStart = GetTimeMillis();
+    uint64_t nTotal = 0, nProcessed = 0;
+    int64_t count = 0, failed = 0, expired = 0, already_there = 0;
+    int64_t nNow = GetTime();
+
+    try {
+        uint64_t version;
+        ssMempool >> version;
+        if (version != MEMPOOL_DUMP_VERSION)
+            return error("%s : unsupported mempool file version %d", __func__, version);
+
+        // Deltas come first so the prioritisation is in effect when the transactions are accepted
+        std::map<uint256, std::pair<double, CAmount> > mapDeltas;
+        ssMempool >> mapDeltas;
+        for (const auto& delta : mapDeltas)
+            pool.PrioritiseTransaction(delta.first, delta.first.ToString(), delta.second.first, delta.second.second);
+
+        ssMempool >> nTotal;
+        pool.SetLoadProgress(0, nTotal);
+
+        std::vector<std::pair<CTransaction, int64_t> > vBatch;
+        vBatch.reserve(MEMPOOL_LOAD_BATCH_SIZE);
+        while (nProcessed < nTotal) {
+            vBatch.clear();
+            while (vBatch.size() < MEMPOOL_LOAD_BATCH_SIZE && nProcessed + vBatch.size() < nTotal) {
+                CTransaction tx;
+                int64_t nTime;
+                ssMempool >> tx >> nTime;
+                vBatch.push_back(std::make_pair(tx, nTime));
+            }
+
+            {
+                // Take cs_main once per batch rather than once per transaction
+                LOCK(cs_main);
+                for (const std::pair<CTransaction, int64_t>& entry : vBatch) {
+                    if (entry.second + nExpiryTimeout <= nNow) {
+                        ++expired;
+                    } else if (pool.exists(entry.first.GetHash())) {
+                        ++already_there;
+                    } else {
+                        CValidationState state;
+                        if (AcceptToMemoryPoolWithTime(pool, state, entry.first, true, NULL, entry.second))
+                            ++count;
+                        else
+                            ++failed;
+                    }
+                }
+            }
+
+            nProcessed += vBatch.size();
+            pool.SetLoadProgress(nProcessed, nTotal);
+            if (ShutdownRequested())
+                return false;
+        }
+    } catch (const std::exception& e) {
+        LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing anyway.\n", e.what());
+        return false;
+    }
+
+    LogPrintf("Imported mempool transactions from disk: %i succeeded, %i failed, %i expired, %i already there (%dms)\n",
+              count, failed, expired, already_there, GetTimeMillis() - nStart);
+    return true;
+}
+
 
 class CMainCleanup
 {
@@ -6405,10 +7414,8 @@ public:
     ~CMainCleanup()
     {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
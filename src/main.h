@@ -51,6 +51,10 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CCoinsViewDB;
+class CBlockFilterDB;
+class CCoinStatsDB;
+class CUTXOSnapshotInfo;
 class CZerocoinDB;
 class CSporkDB;
 class CBloomFilter;
@@ -74,6 +78,10 @@ static const unsigned int DEFAULT_DESCENDANT_SIZE_LIMIT = 101;
 static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 /** Default for -mempoolexpiry, expiration time for mempool transactions in hours */
 static const unsigned int DEFAULT_MEMPOOL_EXPIRY = 72;
+/** Default for -persistmempool */
+static const bool DEFAULT_PERSIST_MEMPOOL = true;
+/** Number of transactions from mempool.dat accepted per cs_main acquisition while reloading */
+static const unsigned int MEMPOOL_LOAD_BATCH_SIZE = 100;
 /** The maximum size for transactions we're willing to relay/mine */
 static const unsigned int MAX_STANDARD_TX_SIZE = 100000;
 static const unsigned int MAX_ZEROCOIN_TX_SIZE = 150000;
@@ -89,6 +97,18 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads scanning block files during -reindex */
+static const int MAX_REINDEX_THREADS = 8;
+/** -reindexthreads default (0 = auto) */
+static const int DEFAULT_REINDEX_THREADS = 0;
+/** Serialized size of the blocks a reindex reader thread may stage per block file */
+static const size_t REINDEX_STAGED_BYTES = 16 * 1024 * 1024;
+/** Maximum number of threads reading blocks ahead of the VerifyDB checks */
+static const int MAX_VERIFYDB_THREADS = 8;
+/** Blocks each VerifyDB reader thread may read ahead of the checks */
+static const int VERIFYDB_READAHEAD_BLOCKS = 16;
+/** -checkblocksbackground default */
+static const bool DEFAULT_CHECKBLOCKS_BACKGROUND = false;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -118,6 +138,17 @@ static const unsigned int AVG_INVENTORY_BROADCAST_INTERVAL = 5;
 /** Enable bloom filter */
  static const bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Default for -blockfilterindex, maintain an index of compact block filters */
+static const bool DEFAULT_BLOCKFILTERINDEX = false;
+/** Default for -peerblockfilters, serve compact block filters to peers */
+static const bool DEFAULT_PEERBLOCKFILTERS = false;
+/** Default for -coinstatsindex, maintain per-block UTXO set statistics */
+static const bool DEFAULT_COINSTATSINDEX = false;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static const uint32_t MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static const uint32_t MAX_GETCFHEADERS_SIZE = 2000;
+
 /** If the tip is older than this (in seconds), the node is considered to be in initial block download. */
 static const int64_t DEFAULT_MAX_TIP_AGE = 24 * 60 * 60;
 
@@ -137,6 +168,8 @@ extern RecursiveMutex cs_main;
 extern CTxMemPool mempool;
 typedef boost::unordered_map<uint256, CBlockIndex*, BlockHasher> BlockMap;
 extern BlockMap mapBlockIndex;
+/** Storage of the entries in mapBlockIndex */
+extern CBlockIndexArena blockIndexArena;
 extern uint64_t nLastBlockTx;
 extern uint64_t nLastBlockSize;
 extern const std::string strMessageMagic;
@@ -152,6 +185,8 @@ extern std::atomic<bool> fImporting;
 extern std::atomic<bool> fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fBlockFilterIndex;
+extern bool fCoinStatsIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern size_t nCoinCacheUsage;
@@ -184,9 +219,10 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
  * @param[in]   pfrom   The node which we are receiving the block from; it is added to mapBlockSource and may be penalised if the block is invalid.
  * @param[in]   pblock  The block we want to process.
  * @param[out]  dbp     If pblock is stored to disk (or already there), this will be set to its location.
+ * @param[in]   fPrechecked  The merkle root and block signature of pblock were verified already.
  * @return True if state.IsValid()
  */
-bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const CBlock* pblock, CDiskBlockPos* dbp = NULL);
+bool ProcessNewBlock(CValidationState& state, CNode* pfrom, const CBlock* pblock, CDiskBlockPos* dbp = NULL, bool fPrechecked = false);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -197,6 +233,8 @@ FILE* OpenUndoFile(const CDiskBlockPos& pos, bool fReadOnly = false);
 fs::path GetBlockPosFilename(const CDiskBlockPos& pos, const char* prefix);
 /** Import blocks from an external file */
 bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp = NULL);
+/** Import all blk?????.dat files in order (-reindex), with nReaders threads reading and prechecking blocks ahead */
+void ReindexBlockFiles(int nReaders);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex();
 /** Load the block tree and coins database from disk */
@@ -237,6 +275,8 @@ CAmount GetBlockValue(int nHeight);
 
 /** Create a new block index entry for a given block hash */
 CBlockIndex* InsertBlockIndex(uint256 hash);
+/** Make the chain of a loaded UTXO snapshot (genesis first) the active chain, see LoadTxOutSet() */
+bool ActivateSnapshotChain(const std::vector<CBlockIndex*>& vChain, const CUTXOSnapshotInfo& info, std::string& strError);
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats& stats);
 /** Increase a node's misbehavior score. */
@@ -248,6 +288,15 @@ void FlushStateToDisk();
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fOverrideMempoolLimit = false, bool fRejectInsaneFee = false, bool ignoreFees = false);
 
+/** (try to) add transaction to memory pool with a specified acceptance time **/
+bool AcceptToMemoryPoolWithTime(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, int64_t nAcceptTime, bool fOverrideMempoolLimit = false, bool fRejectInsaneFee = false, bool ignoreFees = false);
+
+/** Dump the mempool and its prioritisation deltas to disk. */
+bool DumpMempool();
+
+/** Load the mempool from disk, in batches, reporting progress through pool.SetLoadProgress(). */
+bool LoadMempool(CTxMemPool& pool);
+
 bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransaction& tx, bool fLimitFree, bool* pfMissingInputs, bool fRejectInsaneFee = false, bool isDSTX = false);
 
 int GetInputAge(CTxIn& vin);
@@ -374,15 +423,76 @@ bool AcceptBlock(const CBlock& block, CValidationState& state, CBlockIndex** pin
 bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex = NULL);
 
 
-/** RAII wrapper for VerifyDB: Verify consistency of the block and coin databases */
+/**
+ * Where an interrupted VerifyDB run stopped: the blocks from hashTip down to
+ * nHeight passed the checks of levels 0 to nCheckLevel (at most 2), so a run
+ * on a chain that still contains hashTip can skip them.
+ */
+class CVerifyDBProgress
+{
+public:
+    uint256 hashTip;
+    int nCheckLevel;
+    int nHeight;
+
+    CVerifyDBProgress() : nCheckLevel(0), nHeight(0) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(hashTip);
+        READWRITE(nCheckLevel);
+        READWRITE(nHeight);
+    }
+};
+
+/** State of the running or last VerifyDB run */
+struct CVerifyDBStatus {
+    //! "none", "running", "done", "failed" or "interrupted"
+    std::string strState;
+    bool fBackground;
+    int nCheckLevel;
+    //! blocks to check at levels 0-2, of which nVerified are done (nResumed by an earlier run)
+    int nBlocks;
+    int nVerified;
+    int nResumed;
+    //! height of the block being checked, or of the bad block
+    int nHeight;
+    int64_t nStartTime;
+    int64_t nEndTime;
+
+    CVerifyDBStatus() : strState("none"), fBackground(false), nCheckLevel(0), nBlocks(0), nVerified(0), nResumed(0), nHeight(-1), nStartTime(0), nEndTime(0) {}
+};
+
+CVerifyDBStatus GetVerifyDBStatus();
+
+/**
+ * RAII wrapper for VerifyDB: Verify consistency of the block and coin databases.
+ * The checks of levels 0-2 (reading blocks and undo data, CheckBlock) run
+ * on blocks read ahead by several threads, those of levels 3-4 (disconnecting
+ * and reconnecting blocks on a coins cache) consume blocks read ahead the same
+ * way. A background run holds cs_main only for its CheckBlock calls and for
+ * levels 3-4, and records its progress so that it resumes after a restart.
+ */
 class CVerifyDB
 {
+private:
+    const bool fBackground;
+
+    bool VerifyBlocks(int nCheckLevel, int nCheckDepth);
+    bool VerifyCoins(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth);
+
 public:
-    CVerifyDB();
+    explicit CVerifyDB(bool fBackgroundIn = false);
     ~CVerifyDB();
     bool VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth);
 };
 
+/** Verify the last nCheckDepth blocks after startup (-checkblocksbackground), alerting on failure */
+void ThreadVerifyDB(int nCheckDepth);
+
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
@@ -398,6 +508,9 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Global variable that points to the coins database below pcoinsTip (protected by cs_main) */
+extern CCoinsViewDB* pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
@@ -407,6 +520,12 @@ extern CZerocoinDB* zerocoinDB;
 /** Global variable that points to the spork database (protected by cs_main) */
 extern CSporkDB* pSporkDB;
 
+/** Global variable that points to the compact block filter index (NULL unless -blockfilterindex) */
+extern CBlockFilterDB* pblockfilterdb;
+
+/** Global variable that points to the UTXO set statistics index (NULL unless -coinstatsindex) */
+extern CCoinStatsDB* pcoinstatsdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -530,11 +530,13 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
     int nTenthNetwork = CountEnabled() / 10;
     int nCountTenth = 0;
     uint256 nHigh;
+    uint256 hashScore;
+    GetBlockHash(hashScore, nBlockHeight - 100);
     for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeLastPaid) {
         CMasternode* pmn = Find(s.second);
         if (!pmn) break;
 
-        uint256 n = pmn->CalculateScore(1, nBlockHeight - 100);
+        uint256 n = pmn->CalculateScore(hashScore);
         if (n > nHigh) {
             nHigh = n;
             pBestMasternode = pmn;
@@ -581,6 +583,8 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
 {
     int64_t score = 0;
     CMasternode* winner = NULL;
+    uint256 hash;
+    GetBlockHash(hash, nBlockHeight);
 
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
@@ -588,7 +592,7 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
 
         // calculate the score for each Masternode
-        uint256 n = mn.CalculateScore(mod, nBlockHeight);
+        uint256 n = mn.CalculateScore(hash);
         int64_t n2 = n.GetCompact(false);
 
         // determine the winner
@@ -629,7 +633,7 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
             mn.Check();
             if (!mn.IsEnabled()) continue;
         }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
+        uint256 n = mn.CalculateScore(hash);
         int64_t n2 = n.GetCompact(false);
 
         vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
@@ -668,7 +672,7 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
+        uint256 n = mn.CalculateScore(hash);
         int64_t n2 = n.GetCompact(false);
 
         vecMasternodeScores.push_back(std::make_pair(n2, mn));
@@ -688,6 +692,8 @@ std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
     std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    uint256 hash;
+    GetBlockHash(hash, nBlockHeight);
 
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
@@ -697,7 +703,7 @@ CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight
             if (!mn.IsEnabled()) continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
+        uint256 n = mn.CalculateScore(hash);
         int64_t n2 = n.GetCompact(false);
 
         vecMasternodeScores.push_back(std::make_pair(n2, mn.vin));
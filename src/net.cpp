@@ -745,6 +745,16 @@ void CNode::copyStats(CNodeStats& stats)
 
     // Leave string empty if addrLocal invalid (not filled in yet)
     stats.addrLocal = addrLocal.IsValid() ? addrLocal.ToString() : "";
+
+    {
+        LOCK(cs_inventory);
+        X(nInvKnownSkipped);
+        stats.nInvQueued = vInventoryToSend.size();
+    }
+    X(nInvSent);
+    X(nGetDataSent);
+    X(nGetDataTimeouts);
+    stats.nGetDataInFlight = mapGetDataInFlight.size();
 }
 #undef X
 
@@ -2395,6 +2405,10 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nNextLocalAddrSend = 0;
     nNextAddrSend = 0;
     nNextInvSend = 0;
+    nInvSent = 0;
+    nInvKnownSkipped = 0;
+    nGetDataSent = 0;
+    nGetDataTimeouts = 0;
     fRelayTxes = false;
     pfilter = new CBloomFilter();
     nPingNonceSent = 0;
@@ -2432,10 +2446,9 @@ CNode::~CNode()
 
 void CNode::AskFor(const CInv& inv)
 {
-    if (mapAskFor.size() > MAPASKFOR_MAX_SZ)
+    if (queueAskFor.size() > MAPASKFOR_MAX_SZ)
         return;
-    // We're using mapAskFor as a priority queue,
-    // the key is the earliest time the request can be sent
+    // Requests are queued by the earliest time they can be sent
     int64_t nRequestTime;
     limitedmap<CInv, int64_t>::const_iterator it = mapAlreadyAskedFor.find(inv);
     if (it != mapAlreadyAskedFor.end())
@@ -2457,7 +2470,21 @@ void CNode::AskFor(const CInv& inv)
         mapAlreadyAskedFor.update(it, nRequestTime);
     else
         mapAlreadyAskedFor.insert(std::make_pair(inv, nRequestTime));
-    mapAskFor.insert(std::make_pair(nRequestTime, inv));
+    queueAskFor.push(std::make_pair(nRequestTime, inv));
+}
+
+void CNode::MarkGetDataSent(const CInv& inv, int64_t nNow)
+{
+    int64_t nExpiry = nNow + GETDATA_REQUEST_TIMEOUT;
+    mapGetDataInFlight[inv] = nExpiry;
+    vGetDataExpiration.push_back(std::make_pair(nExpiry, inv));
+    nGetDataSent++;
+}
+
+void CNode::MarkGetDataReceived(const CInv& inv)
+{
+    // The matching vGetDataExpiration entry is dropped lazily once it expires
+    mapGetDataInFlight.erase(inv);
 }
 
 void CNode::BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend)
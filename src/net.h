@@ -21,6 +21,7 @@
 #include "utilstrencodings.h"
 
 #include <deque>
+#include <queue>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -63,8 +64,12 @@ static const bool DEFAULT_UPNP = USE_UPNP;
 #else
 static const bool DEFAULT_UPNP = false;
 #endif
-/** The maximum number of entries in mapAskFor */
+/** The maximum number of entries in queueAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** Time (in microseconds) after which an unanswered non-block getdata request is considered timed out */
+static const int64_t GETDATA_REQUEST_TIMEOUT = 2 * 60 * 1000000;
+/** The maximum number of inventory items announced to a peer in a single inv message */
+static const unsigned int MAX_INV_SEND_BATCH = 1000;
 /** The maximum number of peer connections to maintain. */
 static const unsigned int DEFAULT_MAX_PEER_CONNECTIONS = 125;
 /** Disconnected peers are added to setOffsetDisconnectedPeers only if node has less than ENOUGH_CONNECTIONS */
@@ -201,6 +206,12 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    uint64_t nInvSent;
+    uint64_t nInvKnownSkipped;
+    size_t nInvQueued;
+    uint64_t nGetDataSent;
+    size_t nGetDataInFlight;
+    uint64_t nGetDataTimeouts;
 };
 
 
@@ -392,10 +403,21 @@ public:
     CRollingBloomFilter filterInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     RecursiveMutex cs_inventory;
-    std::multimap<int64_t, CInv> mapAskFor;
+    // Pending non-block getdata requests, earliest allowed request time first
+    typedef std::pair<int64_t, CInv> AskForEntry;
+    std::priority_queue<AskForEntry, std::vector<AskForEntry>, std::greater<AskForEntry> > queueAskFor;
+    // Outstanding non-block getdata requests and their expiry time, in request order
+    std::map<CInv, int64_t> mapGetDataInFlight;
+    std::deque<std::pair<int64_t, CInv> > vGetDataExpiration;
     std::vector<uint256> vBlockRequested;
     int64_t nNextInvSend;
 
+    // relay statistics
+    uint64_t nInvSent;
+    uint64_t nInvKnownSkipped;
+    uint64_t nGetDataSent;
+    uint64_t nGetDataTimeouts;
+
     // Ping time measurement:
     // The pong reply we're expecting, or 0 if no pong expected.
     uint64_t nPingNonceSent;
@@ -497,14 +519,23 @@ public:
     {
         {
             LOCK(cs_inventory);
-            if (inv.type == MSG_TX && filterInventoryKnown.contains(inv.hash))
+            // Blocks are always announced, the peer may be asking us to resend them
+            if (inv.type != MSG_BLOCK && filterInventoryKnown.contains(inv.hash)) {
+                nInvKnownSkipped++;
                 return;
+            }
             vInventoryToSend.push_back(inv);
         }
     }
 
     void AskFor(const CInv& inv);
 
+    /** Record a getdata request for a non-block item, expiring after GETDATA_REQUEST_TIMEOUT */
+    void MarkGetDataSent(const CInv& inv, int64_t nNow);
+
+    /** Forget an outstanding getdata request because the item was received */
+    void MarkGetDataReceived(const CInv& inv);
+
     // TODO: Document the postcondition of this function.  Is cs_vSend locked?
     void BeginMessage(const char* pszCommand) EXCLUSIVE_LOCK_FUNCTION(cs_vSend);
 
@@ -11,6 +11,8 @@
 #include "txmempool.h"
 #include "util.h"
 
+#include <boost/thread.hpp>
+
 void TxConfirmStats::Initialize(std::vector<double>& defaultBuckets,
                                 unsigned int maxConfirms, double _decay, std::string _dataTypeString)
 {
@@ -282,6 +284,13 @@ void TxConfirmStats::removeTx(unsigned int entryHeight, unsigned int nBestSeenHe
 }
 
 void CBlockPolicyEstimator::removeTx(uint256 hash)
+{
+    Event event(Event::TX_REMOVED);
+    event.hash = hash;
+    Push(event);
+}
+
+void CBlockPolicyEstimator::ApplyRemoveTx(const uint256& hash)
 {
     std::map<uint256, TxStatsInfo>::iterator pos = mapMemPoolTxs.find(hash);
     if (pos == mapMemPoolTxs.end()) {
@@ -298,8 +307,18 @@ void CBlockPolicyEstimator::removeTx(uint256 hash)
     mapMemPoolTxs.erase(hash);
 }
 
+CFeeEstimatorTx::CFeeEstimatorTx(const CTxMemPoolEntry& entry, unsigned int nPriorityHeight)
+    : hash(entry.GetTx().GetHash()),
+      nFee(entry.GetFee()),
+      feeRate(entry.GetFee(), entry.GetTxSize()),
+      dPriority(entry.GetPriority(nPriorityHeight)),
+      nHeight(entry.GetHeight()),
+      fHasZerocoins(entry.HasZerocoins()),
+      fWasClearAtEntry(entry.WasClearAtEntry())
+{}
+
 CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
-    : nBestSeenHeight(0)
+    : nBestSeenHeight(0), nMaxPublishedTarget(0), fThreadRunning(false), fProcessing(false)
 {
     minTrackedFee = _minRelayFee < CFeeRate(MIN_FEERATE) ? CFeeRate(MIN_FEERATE) : _minRelayFee;
     std::vector<double> vfeelist;
@@ -321,6 +340,111 @@ CBlockPolicyEstimator::CBlockPolicyEstimator(const CFeeRate& _minRelayFee)
     feeLikely = CFeeRate(INF_FEERATE);
     priUnlikely = 0;
     priLikely = INF_PRIORITY;
+
+    for (unsigned int i = 0; i <= MAX_BLOCK_CONFIRMS; i++) {
+        vFeeEstimates[i] = -1;
+        vPriorityEstimates[i] = -1;
+    }
+}
+
+void CBlockPolicyEstimator::Push(Event& event)
+{
+    std::deque<Event> pending;
+    {
+        boost::unique_lock<boost::mutex> lock(csQueue);
+        if (fThreadRunning) {
+            queueEvents.push_back(event);
+            condQueue.notify_one();
+            return;
+        }
+        // Without a consumer apply the event right away, after anything
+        // it left behind when it stopped.
+        pending.swap(queueEvents);
+    }
+    LOCK(cs_estimator);
+    for (const Event& pendingEvent : pending)
+        ProcessEvent(pendingEvent);
+    ProcessEvent(event);
+}
+
+void CBlockPolicyEstimator::ThreadProcessEvents()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csQueue);
+        fThreadRunning = true;
+    }
+    try {
+        while (true) {
+            std::deque<Event> events;
+            {
+                boost::unique_lock<boost::mutex> lock(csQueue);
+                fProcessing = false;
+                condFlushed.notify_all();
+                while (queueEvents.empty())
+                    condQueue.wait(lock);
+                events.swap(queueEvents);
+                fProcessing = true;
+            }
+            LOCK(cs_estimator);
+            for (const Event& event : events)
+                ProcessEvent(event);
+        }
+    } catch (const boost::thread_interrupted&) {
+        boost::unique_lock<boost::mutex> lock(csQueue);
+        fThreadRunning = false;
+        fProcessing = false;
+        condFlushed.notify_all();
+        throw;
+    }
+}
+
+void CBlockPolicyEstimator::Flush()
+{
+    std::deque<Event> pending;
+    {
+        boost::unique_lock<boost::mutex> lock(csQueue);
+        if (fThreadRunning) {
+            while (!queueEvents.empty() || fProcessing)
+                condFlushed.wait(lock);
+            return;
+        }
+        pending.swap(queueEvents);
+    }
+    LOCK(cs_estimator);
+    for (const Event& event : pending)
+        ProcessEvent(event);
+}
+
+void CBlockPolicyEstimator::ProcessEvent(const Event& event)
+{
+    switch (event.type) {
+    case Event::TX_ADDED:
+        for (const CFeeEstimatorTx& tx : event.vtx)
+            ApplyTransaction(tx, event.fCurrentEstimate);
+        break;
+    case Event::TX_REMOVED:
+        ApplyRemoveTx(event.hash);
+        break;
+    case Event::BLOCK:
+        ApplyBlock(event.nBlockHeight, event.vtx, event.fCurrentEstimate);
+        break;
+    }
+}
+
+void CBlockPolicyEstimator::PublishEstimates()
+{
+    unsigned int nMaxTarget = std::min(feeStats.GetMaxConfirms(), priStats.GetMaxConfirms());
+    nMaxTarget = std::min(nMaxTarget, MAX_BLOCK_CONFIRMS);
+    for (unsigned int i = 1; i <= MAX_BLOCK_CONFIRMS; i++) {
+        if (i > nMaxTarget) {
+            vFeeEstimates[i] = -1;
+            vPriorityEstimates[i] = -1;
+            continue;
+        }
+        vFeeEstimates[i] = feeStats.EstimateMedianVal(i, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+        vPriorityEstimates[i] = priStats.EstimateMedianVal(i, SUFFICIENT_PRITXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+    }
+    nMaxPublishedTarget = nMaxTarget;
 }
 
 bool CBlockPolicyEstimator::isFeeDataPoint(const CFeeRate &fee, double pri)
@@ -343,13 +467,21 @@ bool CBlockPolicyEstimator::isPriDataPoint(const CFeeRate &fee, double pri)
 
 void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, bool fCurrentEstimate)
 {
-    if(entry.HasZerocoins()) {
+    Event event(Event::TX_ADDED);
+    event.fCurrentEstimate = fCurrentEstimate;
+    event.vtx.push_back(CFeeEstimatorTx(entry, entry.GetHeight()));
+    Push(event);
+}
+
+void CBlockPolicyEstimator::ApplyTransaction(const CFeeEstimatorTx& tx, bool fCurrentEstimate)
+{
+    if(tx.fHasZerocoins) {
         // Zerocoin spends/mints had fixed fee/priority. Skip them for the estimates.
         return;
     }
 
-    unsigned int txHeight = entry.GetHeight();
-    uint256 hash = entry.GetTx().GetHash();
+    unsigned int txHeight = tx.nHeight;
+    const uint256& hash = tx.hash;
     if (mapMemPoolTxs[hash].stats != nullptr) {
         LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy error mempool tx %s already being tracked\n",
                  hash.ToString().c_str());
@@ -367,7 +499,7 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     if (!fCurrentEstimate)
         return;
 
-    if (!entry.WasClearAtEntry()) {
+    if (!tx.fWasClearAtEntry) {
         // This transaction depends on other transactions in the mempool to
         // be included in a block before it will be able to be included, so
         // we shouldn't include it in our calculations
@@ -375,17 +507,17 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
 
     // Fees are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
+    const CFeeRate& feeRate = tx.feeRate;
 
     // Want the priority of the tx at confirmation. However we don't know
     // what that will be and its too hard to continue updating it
     // so use starting priority as a proxy
-    double curPri = entry.GetPriority(txHeight);
+    double curPri = tx.dPriority;
     mapMemPoolTxs[hash].blockHeight = txHeight;
 
     LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy mempool tx %s ", hash.ToString().substr(0,10));
     // Record this as a priority estimate
-    if (entry.GetFee() == 0 || isPriDataPoint(feeRate, curPri)) {
+    if (tx.nFee == 0 || isPriDataPoint(feeRate, curPri)) {
         mapMemPoolTxs[hash].stats = &priStats;
         mapMemPoolTxs[hash].bucketIndex =  priStats.NewTx(txHeight, curPri);
     }
@@ -399,14 +531,14 @@ void CBlockPolicyEstimator::processTransaction(const CTxMemPoolEntry& entry, boo
     }
 }
 
-void CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry& entry)
+void CBlockPolicyEstimator::ApplyBlockTx(unsigned int nBlockHeight, const CFeeEstimatorTx& tx)
 {
-    if(entry.HasZerocoins()) {
+    if(tx.fHasZerocoins) {
         // Zerocoin spends/mints had fixed fee/priority. Skip them for the estimates.
         return;
     }
 
-    if (!entry.WasClearAtEntry()) {
+    if (!tx.fWasClearAtEntry) {
         // This transaction depended on other transactions in the mempool to
         // be included in a block before it was able to be included, so
         // we shouldn't include it in our calculations
@@ -416,7 +548,7 @@ void CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     // How many blocks did it take for miners to include this transaction?
     // blocksToConfirm is 1-based, so a transaction included in the earliest
     // possible block has confirmation count of 1
-    int blocksToConfirm = nBlockHeight - entry.GetHeight();
+    int blocksToConfirm = nBlockHeight - tx.nHeight;
     if (blocksToConfirm <= 0) {
         // This can't happen because we don't process transactions from a block with a height
         // lower than our greatest seen height
@@ -425,14 +557,14 @@ void CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
     }
 
     // Fees are stored and reported as BTC-per-kb:
-    CFeeRate feeRate(entry.GetFee(), entry.GetTxSize());
+    const CFeeRate& feeRate = tx.feeRate;
 
     // Want the priority of the tx at confirmation.  The priority when it
     // entered the mempool could easily be very small and change quickly
-    double curPri = entry.GetPriority(nBlockHeight);
+    double curPri = tx.dPriority;
 
     // Record this as a priority estimate
-    if (entry.GetFee() == 0 || isPriDataPoint(feeRate, curPri)) {
+    if (tx.nFee == 0 || isPriDataPoint(feeRate, curPri)) {
         priStats.Record(blocksToConfirm, curPri);
     }
     // Record this as a fee estimate
@@ -443,6 +575,18 @@ void CBlockPolicyEstimator::processBlockTx(unsigned int nBlockHeight, const CTxM
 
 void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
                                          std::vector<CTxMemPoolEntry>& entries, bool fCurrentEstimate)
+{
+    Event event(Event::BLOCK);
+    event.nBlockHeight = nBlockHeight;
+    event.fCurrentEstimate = fCurrentEstimate;
+    event.vtx.reserve(entries.size());
+    for (const CTxMemPoolEntry& entry : entries)
+        event.vtx.push_back(CFeeEstimatorTx(entry, nBlockHeight));
+    Push(event);
+}
+
+void CBlockPolicyEstimator::ApplyBlock(unsigned int nBlockHeight,
+                                       const std::vector<CFeeEstimatorTx>& vtx, bool fCurrentEstimate)
 {
     if (nBlockHeight <= nBestSeenHeight) {
         // Ignore side chains and re-orgs; assuming they are random
@@ -488,24 +632,26 @@ void CBlockPolicyEstimator::processBlock(unsigned int nBlockHeight,
     priStats.ClearCurrent(nBlockHeight);
 
     // Repopulate the current block states
-    for (unsigned int i = 0; i < entries.size(); i++)
-        processBlockTx(nBlockHeight, entries[i]);
+    for (unsigned int i = 0; i < vtx.size(); i++)
+        ApplyBlockTx(nBlockHeight, vtx[i]);
 
     // Update all exponential averages with the current block states
     feeStats.UpdateMovingAverages();
     priStats.UpdateMovingAverages();
 
     LogPrint(BCLog::ESTIMATEFEE, "Blockpolicy after updating estimates for %u confirmed entries, new mempool map size %u\n",
-             entries.size(), mapMemPoolTxs.size());
+             vtx.size(), mapMemPoolTxs.size());
+
+    PublishEstimates();
 }
 
-CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
+CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget) const
 {
     // Return failure if trying to analyze a target we're not tracking
-    if (confTarget <= 0 || (unsigned int)confTarget > feeStats.GetMaxConfirms())
+    if (confTarget <= 0 || (unsigned int)confTarget > nMaxPublishedTarget)
         return CFeeRate(0);
 
-    double median = feeStats.EstimateMedianVal(confTarget, SUFFICIENT_FEETXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+    double median = vFeeEstimates[confTarget];
 
     if (median < 0)
         return CFeeRate(0);
@@ -513,17 +659,62 @@ CFeeRate CBlockPolicyEstimator::estimateFee(int confTarget)
     return CFeeRate(median);
 }
 
-double CBlockPolicyEstimator::estimatePriority(int confTarget)
+CFeeRate CBlockPolicyEstimator::estimateSmartFee(int confTarget, int *answerFoundAtTarget) const
 {
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget;
+    const unsigned int nMaxTarget = nMaxPublishedTarget;
     // Return failure if trying to analyze a target we're not tracking
-    if (confTarget <= 0 || (unsigned int)confTarget > priStats.GetMaxConfirms())
+    if (confTarget <= 0 || (unsigned int)confTarget > nMaxTarget)
+        return CFeeRate(0);
+
+    double median = -1;
+    while (median < 0 && (unsigned int)confTarget <= nMaxTarget) {
+        median = vFeeEstimates[confTarget++];
+    }
+
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget - 1;
+
+    if (median < 0)
+        return CFeeRate(0);
+
+    return CFeeRate(median);
+}
+
+double CBlockPolicyEstimator::estimatePriority(int confTarget) const
+{
+    // Return failure if trying to analyze a target we're not tracking
+    if (confTarget <= 0 || (unsigned int)confTarget > nMaxPublishedTarget)
         return -1;
 
-    return priStats.EstimateMedianVal(confTarget, SUFFICIENT_PRITXS, MIN_SUCCESS_PCT, true, nBestSeenHeight);
+    return vPriorityEstimates[confTarget];
+}
+
+double CBlockPolicyEstimator::estimateSmartPriority(int confTarget, int *answerFoundAtTarget) const
+{
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget;
+    const unsigned int nMaxTarget = nMaxPublishedTarget;
+    // Return failure if trying to analyze a target we're not tracking
+    if (confTarget <= 0 || (unsigned int)confTarget > nMaxTarget)
+        return -1;
+
+    double median = -1;
+    while (median < 0 && (unsigned int)confTarget <= nMaxTarget) {
+        median = vPriorityEstimates[confTarget++];
+    }
+
+    if (answerFoundAtTarget)
+        *answerFoundAtTarget = confTarget - 1;
+
+    return median;
 }
 
 void CBlockPolicyEstimator::Write(CAutoFile& fileout)
 {
+    Flush();
+    LOCK(cs_estimator);
     fileout << nBestSeenHeight;
     feeStats.Write(fileout);
     priStats.Write(fileout);
@@ -531,9 +722,12 @@ void CBlockPolicyEstimator::Write(CAutoFile& fileout)
 
 void CBlockPolicyEstimator::Read(CAutoFile& filein)
 {
+    Flush();
+    LOCK(cs_estimator);
     int nFileBestSeenHeight;
     filein >> nFileBestSeenHeight;
     feeStats.Read(filein);
     priStats.Read(filein);
     nBestSeenHeight = nFileBestSeenHeight;
+    PublishEstimates();
 }
@@ -6,12 +6,18 @@
 #define BITCOIN_POLICYESTIMATOR_H
 
 #include "amount.h"
+#include "sync.h"
 #include "uint256.h"
 
+#include <atomic>
+#include <deque>
 #include <map>
 #include <string>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 class CAutoFile;
 class CFeeRate;
 class CTxMemPoolEntry;
@@ -209,10 +215,34 @@ static const double FEE_SPACING = 1.1;
 /** Spacing of Priority buckets */
 static const double PRI_SPACING = 2;
 
+/**
+ * The parts of a mempool entry the estimator looks at, copied when an event
+ * is queued so that processing it never touches the mempool.
+ */
+struct CFeeEstimatorTx
+{
+    uint256 hash;
+    CAmount nFee;
+    CFeeRate feeRate;
+    double dPriority;      //! priority at the height the event refers to
+    unsigned int nHeight;  //! chain height when entering the mempool
+    bool fHasZerocoins;
+    bool fWasClearAtEntry;
+
+    CFeeEstimatorTx(const CTxMemPoolEntry& entry, unsigned int nPriorityHeight);
+};
+
 /**
  *  We want to be able to estimate fees or priorities that are needed on tx's to be included in
  * a certain number of blocks.  Every time a block is added to the best chain, this class records
  * stats on the transactions included in that block
+ *
+ * The mempool feeds the estimator through a queue of (txid, feerate, priority,
+ * height) events, pushed while it holds its own lock. Once
+ * ThreadProcessEvents() is running, a single background consumer applies
+ * them in order; before that (and after it stops) events are applied by the
+ * caller. After every block the estimates for all targets are recomputed and
+ * published in atomics, so estimateFee() and friends never take a lock.
  */
 class CBlockPolicyEstimator
 {
@@ -220,19 +250,22 @@ public:
     /** Create new BlockPolicyEstimator and initialize stats tracking classes with default values */
     CBlockPolicyEstimator(const CFeeRate& minRelayFee);
 
-    /** Process all the transactions that have been included in a block */
+    /** Queue all the transactions that have been included in a block */
     void processBlock(unsigned int nBlockHeight,
                       std::vector<CTxMemPoolEntry>& entries, bool fCurrentEstimate);
 
-    /** Process a transaction confirmed in a block*/
-    void processBlockTx(unsigned int nBlockHeight, const CTxMemPoolEntry& entry);
-
-    /** Process a transaction accepted to the mempool*/
+    /** Queue a transaction accepted to the mempool*/
     void processTransaction(const CTxMemPoolEntry& entry, bool fCurrentEstimate);
 
-    /** Remove a transaction from the mempool tracking stats*/
+    /** Queue the removal of a transaction from the mempool tracking stats*/
     void removeTx(uint256 hash);
 
+    /** Consume queued events until interrupted */
+    void ThreadProcessEvents();
+
+    /** Wait until every event queued so far has been applied */
+    void Flush();
+
     /** Is this transaction likely included in a block because of its fee?*/
     bool isFeeDataPoint(const CFeeRate &fee, double pri);
 
@@ -240,10 +273,22 @@ public:
     bool isPriDataPoint(const CFeeRate &fee, double pri);
 
     /** Return a fee estimate */
-    CFeeRate estimateFee(int confTarget);
+    CFeeRate estimateFee(int confTarget) const;
+
+    /** Estimate fee rate needed to be included in a block within
+     *  confTarget blocks. If no answer can be given at confTarget, return an
+     *  estimate at the lowest target where one can be given.
+     */
+    CFeeRate estimateSmartFee(int confTarget, int *answerFoundAtTarget) const;
 
     /** Return a priority estimate */
-    double estimatePriority(int confTarget);
+    double estimatePriority(int confTarget) const;
+
+    /** Estimate priority needed to be included in a block within
+     *  confTarget blocks. If no answer can be given at confTarget, return an
+     *  estimate at the lowest target where one can be given.
+     */
+    double estimateSmartPriority(int confTarget, int *answerFoundAtTarget) const;
 
     /** Write estimation data to a file */
     void Write(CAutoFile& fileout);
@@ -252,6 +297,20 @@ public:
     void Read(CAutoFile& filein);
 
 private:
+    struct Event
+    {
+        enum Type { TX_ADDED, TX_REMOVED, BLOCK } type;
+        unsigned int nBlockHeight;
+        bool fCurrentEstimate;
+        uint256 hash;
+        std::vector<CFeeEstimatorTx> vtx;
+
+        Event(Type _type) : type(_type), nBlockHeight(0), fCurrentEstimate(false) {}
+    };
+
+    /** Protects the estimation state below, up to the published estimates */
+    RecursiveMutex cs_estimator;
+
     CFeeRate minTrackedFee; //! Passed to constructor to avoid dependency on main
     double minTrackedPriority; //! Set to AllowFreeThreshold
     unsigned int nBestSeenHeight;
@@ -272,5 +331,26 @@ private:
     /** Breakpoints to help determine whether a transaction was confirmed by priority or Fee */
     CFeeRate feeLikely, feeUnlikely;
     double priLikely, priUnlikely;
+
+    /** Estimates per target, -1 when there is none, published after every block */
+    std::atomic<double> vFeeEstimates[MAX_BLOCK_CONFIRMS + 1];
+    std::atomic<double> vPriorityEstimates[MAX_BLOCK_CONFIRMS + 1];
+    std::atomic<unsigned int> nMaxPublishedTarget;
+
+    /** Events not applied yet, and the consumer state */
+    boost::mutex csQueue;
+    boost::condition_variable condQueue;
+    boost::condition_variable condFlushed;
+    std::deque<Event> queueEvents;
+    bool fThreadRunning;
+    bool fProcessing;
+
+    void Push(Event& event);
+    void ProcessEvent(const Event& event);
+    void ApplyTransaction(const CFeeEstimatorTx& tx, bool fCurrentEstimate);
+    void ApplyBlockTx(unsigned int nBlockHeight, const CFeeEstimatorTx& tx);
+    void ApplyBlock(unsigned int nBlockHeight, const std::vector<CFeeEstimatorTx>& vtx, bool fCurrentEstimate);
+    void ApplyRemoveTx(const uint256& hash);
+    void PublishEstimates();
 };
 #endif /*BITCOIN_POLICYESTIMATOR_H */
@@ -12,11 +12,13 @@
 #include "kernel.h"
 #include "main.h"
 #include "rpc/server.h"
+#include "sporkdb.h"
 #include "sync.h"
 #include "txdb.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "wallet/wallet.h"
 #include "ztarn/ztarnmodule.h"
 #include "ztarnchain.h"
@@ -88,7 +90,7 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     result.push_back(Pair("bits", strprintf("%08x", blockindex->nBits)));
     result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
     result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
-    result.push_back(Pair("acc_checkpoint", blockindex->nAccumulatorCheckpoint.GetHex()));
+    result.push_back(Pair("acc_checkpoint", blockindex->GetAccumulatorCheckpoint().GetHex()));
 
     if (blockindex->pprev)
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
@@ -362,6 +364,9 @@ UniValue mempoolToJSON(bool fVerbose = false)
             info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
             info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
             info.push_back(Pair("descendantfees", e.GetFeesWithDescendants()));
+            info.push_back(Pair("ancestorcount", e.GetCountWithAncestors()));
+            info.push_back(Pair("ancestorsize", e.GetSizeWithAncestors()));
+            info.push_back(Pair("ancestorfees", e.GetFeesWithAncestors()));
             const CTransaction& tx = e.GetTx();
             std::set<std::string> setDepends;
             for (const CTxIn& txin : tx.vin) {
@@ -418,6 +423,9 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
             "    \"descendantcount\" : n,  (numeric) number of in-mempool descendant transactions (including this one)\n"
             "    \"descendantsize\" : n,   (numeric) size of in-mempool descendants (including this one)\n"
             "    \"descendantfees\" : n,   (numeric) fees of in-mempool descendants (including this one)\n"
+            "    \"ancestorcount\" : n,    (numeric) number of in-mempool ancestor transactions (including this one)\n"
+            "    \"ancestorsize\" : n,     (numeric) size of in-mempool ancestors (including this one)\n"
+            "    \"ancestorfees\" : n,     (numeric) fees of in-mempool ancestors (including this one)\n"
             "    \"depends\" : [           (array) unconfirmed transactions used as inputs for this transaction\n"
             "        \"transactionid\",    (string) parent transaction id\n"
             "       ... ]\n"
@@ -587,11 +595,17 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw std::runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( hash_or_height )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "With -coinstatsindex the statistics are read from the index, which also\n"
+            "answers for past blocks. Otherwise the chainstate is scanned, which may take\n"
+            "some time and only describes the current tip.\n"
+
+            "\nArguments:\n"
+            "1. hash_or_height   (string or numeric, optional) The block hash or height to report on\n"
+            "                    (requires -coinstatsindex, default: the current tip)\n"
 
             "\nResult:\n"
             "{\n"
@@ -599,16 +613,57 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"bogosize\": n,          (numeric) A database-independent metric for UTXO set size\n"
+            "  \"bytes_serialized\": n,  (numeric) The serialized size (chainstate scan only)\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash (chainstate scan only)\n"
+            "  \"muhash\": \"hash\",     (string) The order-independent MuHash of the set\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "1000") +
+            HelpExampleRpc("gettxoutsetinfo", ""));
 
     UniValue ret(UniValue::VOBJ);
 
+    if (fCoinStatsIndex && pcoinstatsdb) {
+        const CBlockIndex* pindex = NULL;
+        {
+            LOCK(cs_main);
+            pindex = chainActive.Tip();
+            if (params.size() > 0) {
+                const std::string strParam = params[0].isNum() ? std::to_string(params[0].get_int()) : params[0].get_str();
+                int nHeight;
+                if (strParam.size() == 64 && IsHex(strParam)) {
+                    BlockMap::const_iterator it = mapBlockIndex.find(uint256S(strParam));
+                    if (it == mapBlockIndex.end())
+                        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+                    pindex = it->second;
+                } else if (ParseInt32(strParam, &nHeight)) {
+                    if (nHeight < 0 || nHeight > chainActive.Height())
+                        throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
+                    pindex = chainActive[nHeight];
+                } else {
+                    throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected a block hash or height");
+                }
+            }
+        }
+        CCoinStatsEntry entry;
+        if (!pindex || !pcoinstatsdb->ReadStats(pindex->GetBlockHash(), entry))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Unable to read UTXO set statistics from the index");
+        ret.push_back(Pair("height", (int64_t)entry.nHeight));
+        ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
+        ret.push_back(Pair("transactions", (int64_t)entry.nTransactions));
+        ret.push_back(Pair("txouts", (int64_t)entry.nTransactionOutputs));
+        ret.push_back(Pair("bogosize", (int64_t)entry.nBogoSize));
+        ret.push_back(Pair("muhash", entry.hashMuHash.GetHex()));
+        ret.push_back(Pair("total_amount", ValueFromAmount(entry.nTotalAmount)));
+        return ret;
+    }
+
+    if (params.size() > 0)
+        throw JSONRPCError(RPC_MISC_ERROR, "Querying a specific block requires -coinstatsindex");
+
     CCoinsStats stats;
     FlushStateToDisk();
     if (pcoinsTip->GetStats(stats)) {
@@ -616,8 +671,10 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
         ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
         ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
         ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+        ret.push_back(Pair("bogosize", (int64_t)stats.nBogoSize));
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+        ret.push_back(Pair("muhash", stats.hashMuHash.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
     }
     return ret;
@@ -835,6 +892,27 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "        \"status\": \"xxxx\",      (string) status of upgrade\n"
             "        \"info\": \"xxxx\",        (string) additional information about upgrade\n"
             "     }, ...\n"
+            "  },\n"
+            "  \"chainstate_flush\": {        (object) writes of the coins cache to the chainstate database\n"
+            "     \"flushes\": xx,              (numeric) number of writes since startup\n"
+            "     \"in_progress\": true|false,  (boolean) a write is running in the background\n"
+            "     \"last_entries\": xx,         (numeric) cache entries of the last write\n"
+            "     \"last_duration_ms\": xx,     (numeric) duration of the last write\n"
+            "     \"total_duration_ms\": xx,    (numeric) duration of all writes\n"
+            "     \"last_stall_ms\": xx,        (numeric) time the last flush waited for the previous write\n"
+            "     \"total_stall_ms\": xx        (numeric) time all flushes waited for previous writes\n"
+            "  },\n"
+            "  \"verifydb\": {                (object) the running or last check of the last -checkblocks blocks\n"
+            "     \"state\": \"xxxx\",          (string) none, running, done, failed or interrupted\n"
+            "     \"background\": true|false,   (boolean) whether it runs after startup (-checkblocksbackground)\n"
+            "     \"level\": xx,                (numeric) check level\n"
+            "     \"blocks\": xx,               (numeric) blocks to read and check\n"
+            "     \"verified\": xx,             (numeric) blocks read and checked so far\n"
+            "     \"resumed\": xx,              (numeric) blocks checked by an earlier, interrupted run\n"
+            "     \"progress\": xx,             (numeric) verified / blocks\n"
+            "     \"height\": xx,               (numeric) height of the block being checked, or of a bad block\n"
+            "     \"duration\": xx              (numeric) seconds run so far, or until the end\n"
+            "  }\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -862,6 +940,30 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
     }
     obj.push_back(Pair("upgrades", upgrades));
 
+    const CCoinsFlushStats flushStats = pcoinsdbview->GetFlushStats();
+    UniValue flush(UniValue::VOBJ);
+    flush.push_back(Pair("flushes", flushStats.nFlushes));
+    flush.push_back(Pair("in_progress", flushStats.fInProgress));
+    flush.push_back(Pair("last_entries", (uint64_t)flushStats.nLastEntries));
+    flush.push_back(Pair("last_duration_ms", flushStats.nLastDuration / 1000));
+    flush.push_back(Pair("total_duration_ms", flushStats.nTotalDuration / 1000));
+    flush.push_back(Pair("last_stall_ms", flushStats.nLastStall / 1000));
+    flush.push_back(Pair("total_stall_ms", flushStats.nTotalStall / 1000));
+    obj.push_back(Pair("chainstate_flush", flush));
+
+    const CVerifyDBStatus verifyStatus = GetVerifyDBStatus();
+    UniValue verify(UniValue::VOBJ);
+    verify.push_back(Pair("state", verifyStatus.strState));
+    verify.push_back(Pair("background", verifyStatus.fBackground));
+    verify.push_back(Pair("level", verifyStatus.nCheckLevel));
+    verify.push_back(Pair("blocks", verifyStatus.nBlocks));
+    verify.push_back(Pair("verified", verifyStatus.nVerified));
+    verify.push_back(Pair("resumed", verifyStatus.nResumed));
+    verify.push_back(Pair("progress", verifyStatus.nBlocks > 0 ? (double)verifyStatus.nVerified / verifyStatus.nBlocks : 0.0));
+    verify.push_back(Pair("height", verifyStatus.nHeight));
+    verify.push_back(Pair("duration", verifyStatus.nStartTime == 0 ? 0 : (verifyStatus.nEndTime ? verifyStatus.nEndTime : GetTime()) - verifyStatus.nStartTime));
+    obj.push_back(Pair("verifydb", verify));
+
     return obj;
 }
 
@@ -1014,6 +1116,8 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
     ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("loaded", mempool.IsLoaded()));
+    ret.push_back(Pair("loadprogress", mempool.GetLoadProgress()));
 
     return ret;
 }
@@ -1030,6 +1134,8 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"loaded\": true|false         (boolean) True if the mempool is fully loaded\n"
+            "  \"loadprogress\": x.xxx        (numeric) Fraction of mempool.dat reloaded so far (0..1)\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -1038,6 +1144,198 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
     return mempoolInfoToJSON();
 }
 
+UniValue savemempool(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "savemempool\n"
+            "\nDumps the mempool to disk. It will fail until the previous dump is fully loaded.\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("savemempool", "") + HelpExampleRpc("savemempool", ""));
+
+    if (!mempool.IsLoaded())
+        throw JSONRPCError(RPC_MISC_ERROR, "The mempool was not loaded yet");
+
+    if (!DumpMempool())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump mempool to disk");
+
+    return NullUniValue;
+}
+
+static UniValue SnapshotInfoToJSON(const CUTXOSnapshotInfo& info, const fs::path& path)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("base_hash", info.metadata.hashBaseBlock.GetHex()));
+    ret.push_back(Pair("base_height", info.metadata.nBaseHeight));
+    ret.push_back(Pair("transactions", (int64_t)info.stats.nTransactions));
+    ret.push_back(Pair("txouts", (int64_t)info.stats.nTransactionOutputs));
+    ret.push_back(Pair("zerocoin_records", (int64_t)info.nZerocoinRecords));
+    ret.push_back(Pair("total_amount", ValueFromAmount(info.stats.nTotalAmount)));
+    ret.push_back(Pair("money_supply", ValueFromAmount(info.nMoneySupply)));
+    ret.push_back(Pair("muhash", info.stats.hashMuHash.GetHex()));
+    ret.push_back(Pair("snapshot_hash", info.hashSnapshot.GetHex()));
+    return ret;
+}
+
+static const std::string HELP_SNAPSHOT_RESULT =
+    "{\n"
+    "  \"path\": \"path\",          (string) the absolute path of the snapshot\n"
+    "  \"base_hash\": \"hash\",     (string) the block the snapshot was taken at\n"
+    "  \"base_height\": n,         (numeric) the height of that block\n"
+    "  \"transactions\": n,        (numeric) the number of transactions with unspent outputs\n"
+    "  \"txouts\": n,              (numeric) the number of unspent outputs\n"
+    "  \"zerocoin_records\": n,    (numeric) the number of zerocoin database records\n"
+    "  \"total_amount\": x.xxx,    (numeric) the total amount of the unspent outputs\n"
+    "  \"money_supply\": x.xxx,    (numeric) the money supply at the base block\n"
+    "  \"muhash\": \"hash\",        (string) the MuHash of the unspent outputs, as in gettxoutsetinfo\n"
+    "  \"snapshot_hash\": \"hash\"  (string) the checksum of the snapshot, as committed to in chainparams\n"
+    "}\n";
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the UTXO set, zerocoin database and header chain as of the current tip to a\n"
+            "snapshot file, which a new node can start from with loadtxoutset.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) the file to create, relative paths are relative to the data directory\n"
+
+            "\nResult:\n" +
+            HELP_SNAPSHOT_RESULT +
+
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    const fs::path path = fs::absolute(params[0].get_str(), GetDataDir());
+    CUTXOSnapshotInfo info;
+    std::string strError;
+    if (!DumpTxOutSet(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to dump the UTXO set: " + strError);
+
+    return SnapshotInfoToJSON(info, path);
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoads a snapshot written by dumptxoutset and makes its base block the tip, so the node\n"
+            "follows the chain from there on. The snapshot must match one committed to by this\n"
+            "release, and the node must not have any block besides the genesis block yet (start it\n"
+            "with -connect=0). Blocks below the base are not downloaded: the node cannot serve them,\n"
+            "rescan them or reorganize below the base.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) the snapshot file, relative paths are relative to the data directory\n"
+
+            "\nResult:\n" +
+            HELP_SNAPSHOT_RESULT +
+
+            "\nExamples:\n" +
+            HelpExampleCli("loadtxoutset", "\"utxo.dat\"") + HelpExampleRpc("loadtxoutset", "\"utxo.dat\""));
+
+    const fs::path path = fs::absolute(params[0].get_str(), GetDataDir());
+    CUTXOSnapshotInfo info;
+    std::string strError;
+    if (!LoadTxOutSet(path, info, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to load the UTXO snapshot: " + strError);
+
+    return SnapshotInfoToJSON(info, path);
+}
+
+static UniValue DBStatsToJSON(const CDBStats& stats)
+{
+    UniValue levels(UniValue::VARR);
+    uint64_t nBytes = 0;
+    double dCompactionTime = 0;
+    for (const CDBLevelStats& level : stats.vLevels) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("files", level.nFiles));
+        obj.push_back(Pair("bytes", level.nBytes));
+        obj.push_back(Pair("compaction_time", level.dCompactionTime));
+        obj.push_back(Pair("compaction_read", level.nCompactionRead));
+        obj.push_back(Pair("compaction_written", level.nCompactionWritten));
+        levels.push_back(obj);
+        nBytes += level.nBytes;
+        dCompactionTime += level.dCompactionTime;
+    }
+    const uint64_t nLookups = stats.nCacheHits + stats.nCacheMisses;
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("bytes", nBytes));
+    ret.push_back(Pair("compaction_time", dCompactionTime));
+    ret.push_back(Pair("memory_usage", stats.nMemoryUsage));
+    ret.push_back(Pair("cache_usage", (uint64_t)stats.nCacheUsage));
+    ret.push_back(Pair("cache_hits", stats.nCacheHits));
+    ret.push_back(Pair("cache_misses", stats.nCacheMisses));
+    ret.push_back(Pair("cache_hit_rate", nLookups ? (double)stats.nCacheHits / nLookups : 0.0));
+    ret.push_back(Pair("bulk_load", stats.fBulkLoad));
+    ret.push_back(Pair("levels", levels));
+    return ret;
+}
+
+UniValue getdbstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getdbstats\n"
+            "\nReturns the state of each LevelDB database: size and compaction work per level,\n"
+            "memory and block cache use.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"name\": {                  (json object) chainstate, blockindex, zerocoin, sporks, and the enabled indexes\n"
+            "    \"bytes\": n,               (numeric) size of the table files\n"
+            "    \"compaction_time\": x.x,   (numeric) seconds spent compacting since startup\n"
+            "    \"memory_usage\": n,        (numeric) approximate memory used by the write buffers\n"
+            "    \"cache_usage\": n,         (numeric) bytes held by the block cache\n"
+            "    \"cache_hits\": n,          (numeric) block cache lookups that found the block\n"
+            "    \"cache_misses\": n,        (numeric) block cache lookups that had to read it\n"
+            "    \"cache_hit_rate\": x.x,    (numeric) the share of hits\n"
+            "    \"bulk_load\": true|false,  (boolean) whether the database is being bulk loaded\n"
+            "    \"levels\": [               (json array) one object per level, level 0 first\n"
+            "      {\n"
+            "        \"files\": n,           (numeric) number of table files\n"
+            "        \"bytes\": n,           (numeric) size of the table files\n"
+            "        \"compaction_time\": x.x, (numeric) seconds spent on compactions into the level\n"
+            "        \"compaction_read\": n,   (numeric) bytes read by those compactions, in whole MiB\n"
+            "        \"compaction_written\": n (numeric) bytes written by those compactions, in whole MiB\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getdbstats", "") + HelpExampleRpc("getdbstats", ""));
+
+    // Bulk loads reopen databases while holding cs_main
+    LOCK(cs_main);
+    UniValue ret(UniValue::VOBJ);
+    CDBStats stats;
+    pcoinsdbview->GetDBStats(stats);
+    ret.push_back(Pair("chainstate", DBStatsToJSON(stats)));
+    pblocktree->GetStats(stats);
+    ret.push_back(Pair("blockindex", DBStatsToJSON(stats)));
+    zerocoinDB->GetStats(stats);
+    ret.push_back(Pair("zerocoin", DBStatsToJSON(stats)));
+    pSporkDB->GetStats(stats);
+    ret.push_back(Pair("sporks", DBStatsToJSON(stats)));
+    if (pblockfilterdb) {
+        pblockfilterdb->GetStats(stats);
+        ret.push_back(Pair("blockfilter", DBStatsToJSON(stats)));
+    }
+    if (pcoinstatsdb) {
+        pcoinstatsdb->GetStats(stats);
+        ret.push_back(Pair("coinstats", DBStatsToJSON(stats)));
+    }
+    return ret;
+}
+
 UniValue invalidateblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -1360,16 +1658,22 @@ UniValue getblockindexstats(const UniValue& params, bool fHelp) {
         mapPublicSpendCount.insert(std::make_pair(denom, 0));
     }
 
-    CBlockIndex* pindex = nullptr;
+    // Look up the whole range at once, so that a reorg while reading the
+    // blocks cannot leave it half on one branch and half on the other
+    std::vector<int> vHeights;
+    for (int nHeight = heightStart; nHeight <= heightEnd; nHeight++)
+        vHeights.push_back(nHeight);
+    std::vector<const CBlockIndex*> vIndex;
     {
         LOCK(cs_main);
-        pindex = chainActive[heightStart];
+        if (chainActive.Tip())
+            vIndex = chainActive.Tip()->GetAncestors(vHeights);
     }
 
-    if (!pindex)
+    if (vIndex.empty() || std::find(vIndex.begin(), vIndex.end(), nullptr) != vIndex.end())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid block height");
 
-    while (true) {
+    for (const CBlockIndex* pindex : vIndex) {
         CBlock block;
         if (!ReadBlockFromDisk(block, pindex)) {
             throw JSONRPCError(RPC_DATABASE_ERROR, "failed to read block from disk");
@@ -1423,13 +1727,6 @@ UniValue getblockindexstats(const UniValue& params, bool fHelp) {
                 nBytes += GetSerializeSize(tx, SER_NETWORK, CLIENT_VERSION);
             }
         }
-
-        if (pindex->nHeight < heightEnd) {
-            LOCK(cs_main);
-            pindex = chainActive.Next(pindex);
-        } else {
-            break;
-        }
     }
 
     // get fee rate
@@ -120,6 +120,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
         {"getrawmempool", 0},
         {"estimatefee", 0},
         {"estimatepriority", 0},
+        {"estimatesmartfee", 0},
+        {"estimatesmartpriority", 0},
         {"prioritisetransaction", 1},
         {"prioritisetransaction", 2},
         {"setban", 2},
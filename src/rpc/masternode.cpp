@@ -679,8 +679,10 @@ UniValue getmasternodescores (const UniValue& params, bool fHelp)
     for (int nHeight = chainActive.Tip()->nHeight - nLast; nHeight < chainActive.Tip()->nHeight + 20; nHeight++) {
         uint256 nHigh;
         CMasternode* pBestMasternode = NULL;
+        uint256 hash;
+        GetBlockHash(hash, nHeight - 100);
         for (CMasternode& mn : vMasternodes) {
-            uint256 n = mn.CalculateScore(1, nHeight - 100);
+            uint256 n = mn.CalculateScore(hash);
             if (n > nHigh) {
                 nHigh = n;
                 pBestMasternode = &mn;
@@ -12,6 +12,7 @@
 #include "init.h"
 #include "main.h"
 #include "masternode-sync.h"
+#include "memusage.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
@@ -593,6 +594,46 @@ UniValue setmocktime(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue getmemoryinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns an object containing information about memory usage.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"blockindex\": {              (json object) Memory held by the block index\n"
+            "    \"entries\": xxxxx,          (numeric) Number of block index entries\n"
+            "    \"arena\": xxxxx,            (numeric) Bytes allocated for the entries\n"
+            "    \"map\": xxxxx,              (numeric) Bytes used by the hash map indexing them\n"
+            "    \"checkpoints\": xxxxx,      (numeric) Entries with an accumulator checkpoint\n"
+            "    \"checkpointsusage\": xxxxx, (numeric) Bytes used by the accumulator checkpoint table\n"
+            "    \"total\": xxxxx             (numeric) Total bytes\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    LOCK(cs_main);
+    const size_t nArena = blockIndexArena.DynamicMemoryUsage();
+    const size_t nMap = memusage::DynamicUsage(mapBlockIndex);
+    const size_t nCheckpoints = CBlockIndexAccCheckpoint::DynamicMemoryUsage();
+
+    UniValue blockindex(UniValue::VOBJ);
+    blockindex.push_back(Pair("entries", (uint64_t)blockIndexArena.Size()));
+    blockindex.push_back(Pair("arena", (uint64_t)nArena));
+    blockindex.push_back(Pair("map", (uint64_t)nMap));
+    blockindex.push_back(Pair("checkpoints", (uint64_t)CBlockIndexAccCheckpoint::Count()));
+    blockindex.push_back(Pair("checkpointsusage", (uint64_t)nCheckpoints));
+    blockindex.push_back(Pair("total", (uint64_t)(nArena + nMap + nCheckpoints)));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("blockindex", blockindex));
+    return obj;
+}
+
 void EnableOrDisableLogCategories(UniValue cats, bool enable) {
     cats = cats.get_array();
     for (unsigned int i = 0; i < cats.size(); ++i) {
@@ -106,7 +106,16 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"whitelisted\": true|false, (boolean) Whether the peer is whitelisted\n"
+            "    \"relay\": {                 (object) Inventory relay statistics\n"
+            "      \"inv_sent\": n,             (numeric) Inventory items announced to the peer\n"
+            "      \"inv_known_skipped\": n,    (numeric) Announcements skipped because the peer already knew the item\n"
+            "      \"inv_queued\": n,           (numeric) Inventory items waiting for the next announcement batch\n"
+            "      \"getdata_sent\": n,         (numeric) Non-block items requested from the peer\n"
+            "      \"getdata_inflight\": n,     (numeric) Non-block requests still awaiting an answer\n"
+            "      \"getdata_timeouts\": n      (numeric) Non-block requests the peer failed to answer in time\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -158,6 +167,15 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
+        UniValue relay(UniValue::VOBJ);
+        relay.push_back(Pair("inv_sent", stats.nInvSent));
+        relay.push_back(Pair("inv_known_skipped", stats.nInvKnownSkipped));
+        relay.push_back(Pair("inv_queued", (uint64_t)stats.nInvQueued));
+        relay.push_back(Pair("getdata_sent", stats.nGetDataSent));
+        relay.push_back(Pair("getdata_inflight", (uint64_t)stats.nGetDataInFlight));
+        relay.push_back(Pair("getdata_timeouts", stats.nGetDataTimeouts));
+        obj.push_back(Pair("relay", relay));
+
         ret.push_back(obj);
     }
 
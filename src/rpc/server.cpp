@@ -291,6 +291,7 @@ static const CRPCCommand vRPCCommands[] =
         //  --------------------- ------------------------  -----------------------  ----------
         /* Overall control/query calls */
         {"control", "getinfo", &getinfo, true }, /* uses wallet if enabled */
+        {"control", "getmemoryinfo", &getmemoryinfo, true },
         {"control", "help", &help, true },
         {"control", "stop", &stop, true },
 
@@ -324,8 +325,12 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getrawmempool", &getrawmempool, true },
         {"blockchain", "gettxout", &gettxout, true },
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true },
+        {"blockchain", "dumptxoutset", &dumptxoutset, true },
+        {"blockchain", "loadtxoutset", &loadtxoutset, true },
+        {"blockchain", "getdbstats", &getdbstats, true },
         {"blockchain", "invalidateblock", &invalidateblock, true },
         {"blockchain", "reconsiderblock", &reconsiderblock, true },
+        {"blockchain", "savemempool", &savemempool, true },
         {"blockchain", "verifychain", &verifychain, true },
 
         /* Mining */
@@ -359,6 +364,8 @@ static const CRPCCommand vRPCCommands[] =
         {"util", "verifymessage", &verifymessage, true },
         {"util", "estimatefee", &estimatefee, true },
         {"util", "estimatepriority", &estimatepriority, true },
+        {"util", "estimatesmartfee", &estimatesmartfee, true },
+        {"util", "estimatesmartpriority", &estimatesmartpriority, true },
 
         /* Not shown in help */
         {"hidden",              "invalidateblock",        &invalidateblock,        true },
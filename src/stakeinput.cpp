@@ -35,10 +35,21 @@ bool CTarnStake::InitFromTxIn(const CTxIn& txin)
     return true;
 }
 
+bool CTarnStake::InitFromCoin(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex)
+{
+    if (out.IsNull() || !pindex)
+        return error("%s : missing output or block of stake origin", __func__);
+    prevoutFrom = prevout;
+    outFrom = out;
+    pindexFrom = pindex;
+    return true;
+}
+
 bool CTarnStake::SetPrevout(CTransaction txPrev, unsigned int n)
 {
     this->txFrom = txPrev;
-    this->nPosition = n;
+    this->prevoutFrom = COutPoint(txPrev.GetHash(), n);
+    this->outFrom = n < txPrev.vout.size() ? txPrev.vout[n] : CTxOut();
     return true;
 }
 
@@ -52,28 +63,28 @@ bool CTarnStake::GetTxFrom(CTransaction& tx) const
 
 bool CTarnStake::GetTxOutFrom(CTxOut& out) const
 {
-    if (txFrom.IsNull() || nPosition >= txFrom.vout.size())
+    if (outFrom.IsNull())
         return false;
-    out = txFrom.vout[nPosition];
+    out = outFrom;
     return true;
 }
 
 bool CTarnStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(prevoutFrom);
     return true;
 }
 
 CAmount CTarnStake::GetValue() const
 {
-    return txFrom.vout[nPosition].nValue;
+    return outFrom.nValue;
 }
 
 bool CTarnStake::CreateTxOuts(CWallet* pwallet, std::vector<CTxOut>& vout, CAmount nTotal)
 {
     std::vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = outFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions))
         return error("%s: failed to parse kernel", __func__);
 
@@ -123,7 +134,7 @@ CDataStream CTarnStake::GetUniqueness() const
 {
     //The unique identifier for a TARN stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << prevoutFrom.n << prevoutFrom.hash;
     return ss;
 }
 
@@ -134,7 +145,7 @@ CBlockIndex* CTarnStake::GetIndexFrom()
         return pindexFrom;
     uint256 hashBlock = UINT256_ZERO;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(prevoutFrom.hash, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -142,7 +153,7 @@ CBlockIndex* CTarnStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, prevoutFrom.hash.GetHex());
     }
 
     return pindexFrom;
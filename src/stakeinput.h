@@ -36,13 +36,17 @@ public:
 class CTarnStake : public CStakeInput
 {
 private:
+    // Full transaction, unknown when initialized from a coin
     CTransaction txFrom{CTransaction()};
-    unsigned int nPosition{0};
+    COutPoint prevoutFrom;
+    CTxOut outFrom;
 
 public:
     CTarnStake() {}
 
     bool InitFromTxIn(const CTxIn& txin) override;
+    // Initialize from the spent output and the block of its transaction, as the chainstate or undo data know them
+    bool InitFromCoin(const COutPoint& prevout, const CTxOut& out, CBlockIndex* pindex);
     bool SetPrevout(CTransaction txPrev, unsigned int n);
 
     CBlockIndex* GetIndexFrom() override;
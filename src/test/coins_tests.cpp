@@ -5,13 +5,16 @@
 
 #include "coins.h"
 #include "script/standard.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "utilstrencodings.h"
+#include "utiltime.h"
 #include "test/test_tarian.h"
 
 #include <vector>
 #include <map>
 
+#include <boost/thread.hpp>
 #include <boost/test/unit_test.hpp>
 
 namespace
@@ -199,6 +202,52 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_background_flush)
+{
+    CCoinsViewDB coinsdb(1 << 20, true);
+    boost::thread flusher(boost::bind(&CCoinsViewDB::ThreadFlush, &coinsdb));
+    MilliSleep(100);
+
+    // Each generation spends the coins of the previous one and adds its own;
+    // reads right after the hand-over see the new state, written or not.
+    CCoinsViewCache cache(&coinsdb);
+    std::vector<uint256> vTxid;
+    for (int nGen = 0; nGen < 3; nGen++) {
+        if (nGen > 0)
+            cache.ModifyCoins(vTxid.back())->Clear();
+        vTxid.push_back(GetRandHash());
+        {
+            CCoinsModifier coins = cache.ModifyCoins(vTxid.back());
+            coins->vout.resize(1);
+            coins->vout[0] = CTxOut(nGen + 1, CScript() << OP_1);
+            coins->nHeight = nGen;
+        }
+        const uint256 hashBlock = GetRandHash();
+        cache.SetBestBlock(hashBlock);
+        BOOST_CHECK(cache.Flush());
+
+        BOOST_CHECK(coinsdb.GetBestBlock() == hashBlock);
+        CCoins coinsRead;
+        BOOST_CHECK(coinsdb.GetCoins(vTxid.back(), coinsRead));
+        BOOST_CHECK_EQUAL(coinsRead.nHeight, nGen);
+        BOOST_CHECK(cache.HaveCoins(vTxid.back()));
+        if (nGen > 0)
+            BOOST_CHECK(!coinsdb.HaveCoins(vTxid[nGen - 1]));
+    }
+    BOOST_CHECK(coinsdb.WaitFlushed());
+    CCoinsFlushStats stats = coinsdb.GetFlushStats();
+    BOOST_CHECK_EQUAL(stats.nFlushes, 3U);
+    BOOST_CHECK(!stats.fInProgress);
+
+    // Without the thread, batches are written on the spot
+    flusher.interrupt();
+    flusher.join();
+    cache.ModifyCoins(vTxid.back())->Clear();
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!coinsdb.HaveCoins(vTxid.back()));
+    BOOST_CHECK_EQUAL(coinsdb.GetFlushStats().nFlushes, 4U);
+}
+
 BOOST_AUTO_TEST_CASE(ccoins_serialization)
 {
     // Good example
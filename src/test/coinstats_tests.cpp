@@ -0,0 +1,128 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "coins.h"
+#include "main.h"
+#include "primitives/block.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "undo.h"
+#include "test/test_tarian.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinstats_tests, BasicTestingSetup)
+
+// Connect the transactions of a block to the view the way ConnectBlock does,
+// collecting the undo data of every non-coinbase transaction.
+static CBlockUndo ConnectToView(const CBlock& block, CCoinsViewCache& view, int nHeight)
+{
+    CBlockUndo blockundo;
+    CTxUndo undoDummy;
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        if (i > 0)
+            blockundo.vtxundo.emplace_back();
+        UpdateCoins(block.vtx[i], view, i == 0 ? undoDummy : blockundo.vtxundo.back(), nHeight);
+    }
+    return blockundo;
+}
+
+// Compute the statistics of the given transactions' unspent outputs from scratch.
+static CCoinStatsEntry ScanView(const CCoinsViewCache& view, const std::vector<uint256>& vTxid)
+{
+    CCoinStatsEntry entry;
+    for (const uint256& txid : vTxid) {
+        const CCoins* coins = view.AccessCoins(txid);
+        if (!coins || coins->IsPruned())
+            continue;
+        entry.nTransactions++;
+        for (unsigned int i = 0; i < coins->vout.size(); i++) {
+            const CTxOut& out = coins->vout[i];
+            if (out.IsNull())
+                continue;
+            ApplyCoinToMuHash(entry.muhash, COutPoint(txid, i), out, false);
+            entry.nTransactionOutputs++;
+            entry.nBogoSize += GetBogoSize(out.scriptPubKey);
+            entry.nTotalAmount += out.nValue;
+        }
+    }
+    entry.muhash.Finalize(entry.hashMuHash);
+    return entry;
+}
+
+static void CheckEqual(const CCoinStatsEntry& a, const CCoinStatsEntry& b)
+{
+    BOOST_CHECK_EQUAL(a.nTransactions, b.nTransactions);
+    BOOST_CHECK_EQUAL(a.nTransactionOutputs, b.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(a.nBogoSize, b.nBogoSize);
+    BOOST_CHECK_EQUAL(a.nTotalAmount, b.nTotalAmount);
+    BOOST_CHECK(a.hashMuHash == b.hashMuHash);
+}
+
+static CMutableTransaction CreateCoinbase(int nHeight, std::vector<CTxOut> vout)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << nHeight << OP_0;
+    tx.vout = vout;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(coinstats_incremental)
+{
+    const CScript script = CScript() << OP_1;
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+
+    // Block 1 creates two spendable outputs and a provably unspendable one
+    CBlock block1;
+    block1.vtx.push_back(CreateCoinbase(1, {CTxOut(50 * COIN, script), CTxOut(25 * COIN, script), CTxOut(0, CScript() << OP_RETURN)}));
+    const uint256 txid1 = block1.vtx[0].GetHash();
+    CBlockUndo undo1 = ConnectToView(block1, view, 1);
+
+    CCoinStatsEntry entry;
+    entry.ApplyBlock(block1, undo1, 1);
+    BOOST_CHECK_EQUAL(entry.nHeight, 1);
+    BOOST_CHECK_EQUAL(entry.nTransactions, 1U);
+    BOOST_CHECK_EQUAL(entry.nTransactionOutputs, 2U);
+    BOOST_CHECK_EQUAL(entry.nTotalAmount, 75 * COIN);
+    CheckEqual(entry, ScanView(view, {txid1}));
+
+    // Block 2 spends both outputs of block 1 and chains a second spend
+    // inside the block, so one transaction appears and vanishes in it.
+    CBlock block2;
+    block2.vtx.push_back(CreateCoinbase(2, {CTxOut(10 * COIN, script)}));
+    CMutableTransaction spend1;
+    spend1.vin.emplace_back(COutPoint(txid1, 0));
+    spend1.vin.emplace_back(COutPoint(txid1, 1));
+    spend1.vout.emplace_back(74 * COIN, script);
+    block2.vtx.push_back(spend1);
+    CMutableTransaction spend2;
+    spend2.vin.emplace_back(COutPoint(block2.vtx[1].GetHash(), 0));
+    spend2.vout.emplace_back(40 * COIN, script);
+    spend2.vout.emplace_back(33 * COIN, CScript() << OP_2);
+    block2.vtx.push_back(spend2);
+    CBlockUndo undo2 = ConnectToView(block2, view, 2);
+
+    // Entries survive the round trip through the index database encoding
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << entry;
+    CCoinStatsEntry entryRead;
+    ss >> entryRead;
+    CheckEqual(entry, entryRead);
+
+    entryRead.ApplyBlock(block2, undo2, 2);
+    BOOST_CHECK_EQUAL(entryRead.nHeight, 2);
+    BOOST_CHECK_EQUAL(entryRead.nTransactions, 2U);
+    BOOST_CHECK_EQUAL(entryRead.nTransactionOutputs, 3U);
+    BOOST_CHECK_EQUAL(entryRead.nTotalAmount, 83 * COIN);
+    std::vector<uint256> vTxid = {txid1};
+    for (const CTransaction& tx : block2.vtx)
+        vTxid.push_back(tx.GetHash());
+    CheckEqual(entryRead, ScanView(view, vTxid));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
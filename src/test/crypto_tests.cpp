@@ -12,6 +12,8 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/muhash.h"
+#include "streams.h"
 #include "random.h"
 #include "utilstrencodings.h"
 #include "test/test_tarian.h"
@@ -451,6 +453,86 @@ BOOST_AUTO_TEST_CASE(chacha20_testvector)
                  "fab78c9");
 }
 
+static MuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return MuHash3072(tmp, sizeof(tmp));
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    uint256 out;
+
+    for (int iter = 0; iter < 10; ++iter) {
+        uint256 res;
+        int table[4];
+        for (int i = 0; i < 4; ++i) {
+            table[i] = InsecureRand32() % 8;
+        }
+        for (int order = 0; order < 4; ++order) {
+            MuHash3072 acc;
+            for (int i = 0; i < 4; ++i) {
+                int t = table[i ^ order];
+                if (t & 4) {
+                    acc /= FromInt(t & 3);
+                } else {
+                    acc *= FromInt(t & 3);
+                }
+            }
+            acc.Finalize(out);
+            if (order == 0) {
+                res = out;
+            } else {
+                BOOST_CHECK(res == out);
+            }
+        }
+
+        // Removing an element that was inserted gives back the same hash
+        // as never having inserted it, whichever order it happens in.
+        MuHash3072 x = FromInt(InsecureRand32() & 0xFF);
+        MuHash3072 y = FromInt(InsecureRand32() & 0xFF);
+        uint256 out2;
+        MuHash3072 z; // Empty set
+        z *= x;
+        z *= y;
+        y *= x;
+        y /= z;
+        y.Finalize(out);
+        z = MuHash3072();
+        z.Finalize(out2);
+        BOOST_CHECK(out == out2);
+
+        unsigned char data[32] = {(unsigned char)iter, 1};
+        MuHash3072 a, b;
+        a.Insert(data, sizeof(data));
+        a.Remove(data, sizeof(data));
+        a.Finalize(out);
+        BOOST_CHECK(out == out2);
+        b.Remove(data, sizeof(data));
+        b.Insert(data, sizeof(data));
+        b.Finalize(out);
+        BOOST_CHECK(out == out2);
+    }
+
+    MuHash3072 acc = FromInt(0);
+    acc *= FromInt(1);
+    acc /= FromInt(2);
+    acc.Finalize(out);
+    BOOST_CHECK(out == uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+
+    // The state survives a serialization round trip
+    MuHash3072 acc2 = FromInt(0);
+    acc2 *= FromInt(1);
+    acc2 /= FromInt(2);
+    CDataStream ss(SER_DISK, 0);
+    ss << acc2;
+    BOOST_CHECK_EQUAL(ss.size(), 2 * Num3072::BYTE_SIZE);
+    MuHash3072 acc3;
+    ss >> acc3;
+    acc3.Finalize(out);
+    BOOST_CHECK(out == uint256S("10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863"));
+}
+
 BOOST_AUTO_TEST_CASE(countbits_tests)
 {
     FastRandomContext ctx;
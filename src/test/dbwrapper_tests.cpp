@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "chain.h"
 #include "dbwrapper.h"
 #include "uint256.h"
 #include "random.h"
@@ -9,6 +10,7 @@
 
 #include <boost/assign/std/vector.hpp> // for 'operator+=()'
 #include <boost/assert.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/test/unit_test.hpp>
 
 // Test if a string consists entirely of null characters
@@ -113,4 +115,100 @@ BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_bulkload)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBOptions dbOptions;
+    dbOptions.nBulkWriteBufferSize = 4 << 20;
+    CDBWrapper dbw(ph, (1 << 20), true, false, dbOptions);
+
+    // Records written while bulk loading survive the reopens
+    dbw.SetBulkLoad(true);
+    CDBStats stats;
+    dbw.GetStats(stats);
+    BOOST_CHECK(stats.fBulkLoad);
+    CDBBatch batch;
+    for (int i = 0; i < 2000; i++)
+        batch.Write(std::make_pair('k', i), GetRandHash());
+    BOOST_CHECK(dbw.WriteBatch(batch));
+    dbw.SetBulkLoad(false);
+    dbw.Compact();
+
+    uint256 res;
+    for (int i = 0; i < 2000; i++)
+        BOOST_CHECK(dbw.Read(std::make_pair('k', i), res));
+
+    // Compacting moved everything out of level 0
+    dbw.GetStats(stats);
+    BOOST_CHECK(!stats.fBulkLoad);
+    BOOST_CHECK(stats.vLevels.size() > 1);
+    BOOST_CHECK_EQUAL(stats.vLevels[0].nFiles, 0);
+    int nFiles = 0;
+    uint64_t nBytes = 0;
+    for (const CDBLevelStats& level : stats.vLevels) {
+        nFiles += level.nFiles;
+        nBytes += level.nBytes;
+    }
+    BOOST_CHECK(nFiles > 0);
+    BOOST_CHECK(nBytes > 2000 * 32);
+
+    // The reads went through the block cache
+    BOOST_CHECK(stats.nCacheHits + stats.nCacheMisses >= 2000);
+    BOOST_CHECK(stats.nCacheHits > 0);
+}
+
+BOOST_AUTO_TEST_CASE(dbwrapper_diskblockindex)
+{
+    fs::path ph = fs::temp_directory_path() / fs::unique_path();
+    CDBWrapper dbw(ph, (1 << 20), true, false);
+
+    CBlockIndex index;
+    uint256 hash = GetRandHash();
+    index.phashBlock = &hash;
+    index.nHeight = 10;
+    index.nVersion = 3;
+    index.nTime = 1234567;
+    index.nBits = 0x1e0ffff0;
+    index.hashMerkleRoot = GetRandHash();
+
+    // New records carry their hash
+    BOOST_CHECK(dbw.Write('b', CDiskBlockIndex(&index)));
+    CDiskBlockIndex diskindex;
+    BOOST_CHECK(dbw.Read('b', diskindex));
+    BOOST_CHECK(diskindex.HasStoredHash());
+    BOOST_CHECK(diskindex.GetBlockHash() == hash);
+    BOOST_CHECK_EQUAL(diskindex.nHeight, 10);
+    BOOST_CHECK(diskindex.hashMerkleRoot == index.hashMerkleRoot);
+
+    // The raw value read through an iterator deserializes to the same record
+    boost::scoped_ptr<CDBIterator> it(const_cast<CDBWrapper*>(&dbw)->NewIterator());
+    it->Seek('b');
+    BOOST_CHECK(it->Valid());
+    std::vector<char> vchValue;
+    it->GetValueBytes(vchValue);
+    BOOST_CHECK_EQUAL(vchValue.size(), it->GetValueSize());
+    CDataStream ssValue(vchValue.data(), vchValue.data() + vchValue.size(), SER_DISK, CLIENT_VERSION);
+    CDiskBlockIndex diskindex2;
+    ssValue >> diskindex2;
+    BOOST_CHECK(diskindex2.GetBlockHash() == hash);
+
+    // Records from before DBI_SER_VERSION_HASH have their hash computed from the header
+    CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+    int nSerVersion = DBI_SER_VERSION_NO_ZC;
+    ssLegacy << VARINT(nSerVersion) << VARINT(index.nHeight) << VARINT(index.nStatus) << VARINT(index.nTx);
+    ssLegacy << index.nFlags << index.nVersion << index.GetStakeModifierBytes() << UINT256_ZERO << index.hashMerkleRoot;
+    ssLegacy << index.nTime << index.nBits << index.nNonce;
+    CDiskBlockIndex legacy;
+    ssLegacy >> legacy;
+    BOOST_CHECK(ssLegacy.empty());
+    BOOST_CHECK(!legacy.HasStoredHash());
+    BOOST_CHECK(legacy.GetBlockHash() == legacy.ComputeBlockHash());
+    CBlockHeader header;
+    header.nVersion = index.nVersion;
+    header.hashMerkleRoot = index.hashMerkleRoot;
+    header.nTime = index.nTime;
+    header.nBits = index.nBits;
+    BOOST_CHECK(legacy.GetBlockHash() == header.GetHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
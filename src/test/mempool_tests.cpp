@@ -382,8 +382,8 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     tx7.vout.resize(2);
     tx7.vout[0].scriptPubKey = CScript() << OP_7 << OP_EQUAL;
     tx7.vout[0].nValue = 10 * COIN;
-    tx7.vout[0].scriptPubKey = CScript() << OP_7 << OP_EQUAL;
-    tx7.vout[0].nValue = 10 * COIN;
+    tx7.vout[1].scriptPubKey = CScript() << OP_7 << OP_EQUAL;
+    tx7.vout[1].nValue = 10 * COIN;
 
     pool.addUnchecked(tx4.GetHash(), entry.Fee(7000LL).FromTx(tx4, &pool));
     pool.addUnchecked(tx5.GetHash(), entry.Fee(1000LL).FromTx(tx5, &pool));
@@ -439,4 +439,96 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorStateTest)
+{
+    TestMemPoolEntryHelper entry;
+    CTxMemPool pool(CFeeRate(0));
+
+    // txA has two outputs, spent by txB and txD; txC spends txB.
+    CMutableTransaction txA;
+    txA.vin.resize(1);
+    txA.vin[0].scriptSig = CScript() << OP_11;
+    txA.vout.resize(2);
+    for (int i = 0; i < 2; i++) {
+        txA.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txA.vout[i].nValue = 20 * COIN;
+    }
+    CMutableTransaction txB;
+    txB.vin.resize(1);
+    txB.vin[0].scriptSig = CScript() << OP_11;
+    txB.vin[0].prevout = COutPoint(txA.GetHash(), 0);
+    txB.vout.resize(1);
+    txB.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txB.vout[0].nValue = 19 * COIN;
+    CMutableTransaction txC;
+    txC.vin.resize(1);
+    txC.vin[0].scriptSig = CScript() << OP_11;
+    txC.vin[0].prevout = COutPoint(txB.GetHash(), 0);
+    txC.vout.resize(1);
+    txC.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txC.vout[0].nValue = 18 * COIN;
+    CMutableTransaction txD;
+    txD.vin.resize(1);
+    txD.vin[0].scriptSig = CScript() << OP_11;
+    txD.vin[0].prevout = COutPoint(txA.GetHash(), 1);
+    txD.vout.resize(1);
+    txD.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txD.vout[0].nValue = 19 * COIN;
+
+    pool.addUnchecked(txA.GetHash(), entry.Fee(1000LL).FromTx(txA));
+    pool.addUnchecked(txB.GetHash(), entry.Fee(2000LL).FromTx(txB));
+    pool.addUnchecked(txC.GetHash(), entry.Fee(3000LL).FromTx(txC));
+    pool.addUnchecked(txD.GetHash(), entry.Fee(4000LL).FromTx(txD));
+
+    CTxMemPool::txiter itA = pool.mapTx.find(txA.GetHash());
+    CTxMemPool::txiter itB = pool.mapTx.find(txB.GetHash());
+    CTxMemPool::txiter itC = pool.mapTx.find(txC.GetHash());
+    CTxMemPool::txiter itD = pool.mapTx.find(txD.GetHash());
+    BOOST_CHECK_EQUAL(itA->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(itA->GetCountWithDescendants(), 4);
+    BOOST_CHECK_EQUAL(itA->GetFeesWithDescendants(), 10000LL);
+    BOOST_CHECK_EQUAL(itC->GetCountWithAncestors(), 3);
+    BOOST_CHECK_EQUAL(itC->GetFeesWithAncestors(), 6000LL);
+    BOOST_CHECK_EQUAL(itC->GetSizeWithAncestors(), itA->GetTxSize() + itB->GetTxSize() + itC->GetTxSize());
+    BOOST_CHECK_EQUAL(itD->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(itD->GetFeesWithAncestors(), 5000LL);
+
+    // A parent with its own ancestors too close to the limit is rejected
+    // before the graph is walked.
+    std::string errString;
+    CTxMemPool::setEntries setAncestors;
+    CMutableTransaction txE;
+    txE.vin.resize(1);
+    txE.vin[0].prevout = COutPoint(txC.GetHash(), 0);
+    txE.vout.resize(1);
+    txE.vout[0].nValue = 17 * COIN;
+    BOOST_CHECK(!pool.CalculateMemPoolAncestors(entry.FromTx(txE), setAncestors, 3, 1000000, 1000, 1000000, errString));
+    BOOST_CHECK(setAncestors.empty());
+    BOOST_CHECK(pool.CalculateMemPoolAncestors(entry.FromTx(txE), setAncestors, 4, 1000000, 1000, 1000000, errString));
+    BOOST_CHECK_EQUAL(setAncestors.size(), 3);
+
+    // Confirming txA leaves its descendants in the pool with updated
+    // ancestor state.
+    std::vector<CTransaction> vtx;
+    vtx.push_back(txA);
+    std::list<CTransaction> conflicts;
+    pool.removeForBlock(vtx, 1, conflicts, false);
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+    BOOST_CHECK(conflicts.empty());
+    BOOST_CHECK_EQUAL(itB->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(itB->GetFeesWithAncestors(), 2000LL);
+    BOOST_CHECK_EQUAL(itC->GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(itC->GetSizeWithAncestors(), itB->GetTxSize() + itC->GetTxSize());
+    BOOST_CHECK_EQUAL(itD->GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(itB->GetCountWithDescendants(), 2);
+
+    // Evicting txC updates the descendant state of txB.
+    std::list<CTransaction> removed;
+    pool.remove(txC, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK_EQUAL(itB->GetCountWithDescendants(), 1);
+    BOOST_CHECK_EQUAL(itB->GetFeesWithDescendants(), 2000LL);
+    BOOST_CHECK_EQUAL(itB->GetSizeWithDescendants(), itB->GetTxSize());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -174,4 +174,40 @@ BOOST_AUTO_TEST_CASE(cnode_simple_test)
     BOOST_CHECK(pnode2->fFeeler == false);
 }
 
+BOOST_AUTO_TEST_CASE(cnode_inventory_relay)
+{
+    in_addr ipv4Addr;
+    ipv4Addr.s_addr = 0xa0b0c001;
+    CAddress addr = CAddress(CService(ipv4Addr, 7777), NODE_NETWORK);
+    CNode node(INVALID_SOCKET, addr, "", false);
+
+    // Items the peer already knows about are not queued again, blocks always are
+    CInv txKnown(MSG_TX, GetRandHash());
+    CInv txNew(MSG_TX, GetRandHash());
+    CInv blockKnown(MSG_BLOCK, GetRandHash());
+    node.AddInventoryKnown(txKnown);
+    node.AddInventoryKnown(blockKnown);
+    node.PushInventory(txKnown);
+    node.PushInventory(txNew);
+    node.PushInventory(blockKnown);
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 2);
+    BOOST_CHECK_EQUAL(node.nInvKnownSkipped, 1);
+
+    // Pending requests come out earliest first
+    CInv inv1(MSG_TX, GetRandHash());
+    CInv inv2(MSG_TX, GetRandHash());
+    node.queueAskFor.push(std::make_pair(200, inv1));
+    node.queueAskFor.push(std::make_pair(100, inv2));
+    BOOST_CHECK(node.queueAskFor.top().second.hash == inv2.hash);
+
+    // In-flight requests are forgotten once answered
+    node.MarkGetDataSent(inv1, 0);
+    node.MarkGetDataSent(inv2, 0);
+    BOOST_CHECK_EQUAL(node.mapGetDataInFlight.size(), 2);
+    node.MarkGetDataReceived(inv1);
+    BOOST_CHECK_EQUAL(node.mapGetDataInFlight.size(), 1);
+    BOOST_CHECK_EQUAL(node.nGetDataSent, 2);
+    BOOST_CHECK(node.vGetDataExpiration.front().first == GETDATA_REQUEST_TIMEOUT);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -9,7 +9,9 @@
 
 #include "test/test_tarian.h"
 
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(policyestimator_tests, BasicTestingSetup)
 
@@ -184,4 +186,62 @@ BOOST_AUTO_TEST_CASE(BlockPolicyEstimates)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BlockPolicyEstimatorThread)
+{
+    // Feed the same history to an estimator applying events inline and to
+    // one with a background consumer; after a flush both must agree.
+    CBlockPolicyEstimator inlineEst(CFeeRate(1000));
+    CBlockPolicyEstimator threadEst(CFeeRate(1000));
+    boost::thread consumer(boost::bind(&CBlockPolicyEstimator::ThreadProcessEvents, &threadEst));
+
+    TestMemPoolEntryHelper entry;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 0LL;
+
+    for (unsigned int blocknum = 1; blocknum <= 150; blocknum++) {
+        std::vector<CTxMemPoolEntry> vBlock;
+        for (int j = 0; j < 10; j++) {
+            tx.vin[0].prevout.n = 100 * blocknum + j;
+            CTxMemPoolEntry txEntry = entry.Fee(2000 * (j + 1)).Priority(0).Height(blocknum).HadNoDependencies(true).FromTx(tx);
+            inlineEst.processTransaction(txEntry, true);
+            threadEst.processTransaction(txEntry, true);
+            // Higher fee transactions confirm in the next block, lower ones
+            // are dropped. Either way they leave the mempool first.
+            inlineEst.removeTx(txEntry.GetTx().GetHash());
+            threadEst.removeTx(txEntry.GetTx().GetHash());
+            if (j >= 5)
+                vBlock.push_back(txEntry);
+        }
+        inlineEst.processBlock(blocknum + 1, vBlock, true);
+        threadEst.processBlock(blocknum + 1, vBlock, true);
+    }
+
+    threadEst.Flush();
+    for (int i = 1; i <= 25; i++) {
+        BOOST_CHECK(inlineEst.estimateFee(i) == threadEst.estimateFee(i));
+        BOOST_CHECK_EQUAL(inlineEst.estimatePriority(i), threadEst.estimatePriority(i));
+    }
+    BOOST_CHECK(threadEst.estimateFee(1) > CFeeRate(0));
+
+    // Smart estimates answer at the requested target when it has an estimate
+    // and never for targets outside the tracked range.
+    int answerFound;
+    BOOST_CHECK(threadEst.estimateSmartFee(1, &answerFound) == threadEst.estimateFee(1));
+    BOOST_CHECK_EQUAL(answerFound, 1);
+    BOOST_CHECK(threadEst.estimateSmartFee(0, &answerFound) == CFeeRate(0));
+    BOOST_CHECK(threadEst.estimateSmartFee(MAX_BLOCK_CONFIRMS + 1, &answerFound) == CFeeRate(0));
+
+    consumer.interrupt();
+    consumer.join();
+
+    // Once the consumer is gone events are applied by the caller again
+    std::vector<CTxMemPoolEntry> vEmpty;
+    inlineEst.processBlock(200, vEmpty, true);
+    threadEst.processBlock(200, vEmpty, true);
+    for (int i = 1; i <= 25; i++)
+        BOOST_CHECK(inlineEst.estimateFee(i) == threadEst.estimateFee(i));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
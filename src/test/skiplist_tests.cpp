@@ -44,6 +44,46 @@ BOOST_AUTO_TEST_CASE(skiplist_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(getancestors_test)
+{
+    std::vector<CBlockIndex> vIndex(SKIPLIST_LENGTH);
+    int64_t nTime = 1000000;
+    for (int i=0; i<SKIPLIST_LENGTH; i++) {
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = (i == 0) ? NULL : &vIndex[i - 1];
+        // Block times going back now and then, so the median is not the middle block
+        nTime += (int64_t)InsecureRandRange(120) - 30;
+        vIndex[i].nTime = nTime;
+        vIndex[i].BuildSkip();
+    }
+
+    // The cached median time past is the one computed on demand
+    for (int i=0; i < 1000; i++) {
+        CBlockIndex& index = vIndex[InsecureRandRange(SKIPLIST_LENGTH)];
+        const int64_t nMedianTimePast = index.GetMedianTimePast();
+        index.BuildMedianTimePast();
+        BOOST_CHECK_EQUAL((int64_t)index.nMedianTimePast, nMedianTimePast);
+        BOOST_CHECK_EQUAL(index.GetMedianTimePast(), nMedianTimePast);
+    }
+
+    for (int i=0; i < 100; i++) {
+        const CBlockIndex& from = vIndex[InsecureRandRange(SKIPLIST_LENGTH)];
+        // Unsorted heights with repeats and some out of range
+        std::vector<int> vHeights;
+        for (int j=0; j < 50; j++)
+            vHeights.push_back(InsecureRandRange(from.nHeight + 1));
+        vHeights.push_back(from.nHeight);
+        vHeights.push_back(vHeights[0]);
+        vHeights.push_back(from.nHeight + 1);
+        vHeights.push_back(-1);
+
+        std::vector<const CBlockIndex*> vAncestors = from.GetAncestors(vHeights);
+        BOOST_CHECK_EQUAL(vAncestors.size(), vHeights.size());
+        for (size_t j=0; j < vHeights.size(); j++)
+            BOOST_CHECK(vAncestors[j] == from.GetAncestor(vHeights[j]));
+    }
+}
+
 BOOST_AUTO_TEST_CASE(getlocator_test)
 {
     // Build a main chain 100000 blocks long.
@@ -100,4 +140,57 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     }
 }
 
+BOOST_AUTO_TEST_CASE(blockindex_compact_test)
+{
+    CBlockIndexArena arena;
+    const size_t nEntries = CBlockIndexArena::ENTRIES_PER_CHUNK + 10;
+    const size_t nCheckpointsBefore = CBlockIndexAccCheckpoint::Count();
+    std::vector<CBlockIndex*> vIndex;
+    for (size_t i = 0; i < nEntries; i++) {
+        vIndex.push_back(arena.New());
+        vIndex.back()->nHeight = i;
+        vIndex.back()->pprev = i ? vIndex[i - 1] : NULL;
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), nEntries);
+    BOOST_CHECK(arena.DynamicMemoryUsage() >= 2 * CBlockIndexArena::ENTRIES_PER_CHUNK * sizeof(CBlockIndex));
+    for (size_t i = 0; i < nEntries; i++)
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, (int)i);
+
+    // Stake modifiers round trip through their serialized form
+    CBlockIndex* pindex = vIndex[5];
+    BOOST_CHECK(pindex->GetStakeModifierBytes().empty());
+    pindex->SetStakeModifier(0x0123456789abcdefULL, false);
+    BOOST_CHECK_EQUAL(pindex->GetStakeModifierBytes().size(), 8U);
+    BOOST_CHECK_EQUAL(pindex->GetStakeModifierV1(), 0x0123456789abcdefULL);
+    const uint256 nModifierV2 = GetRandHash();
+    pindex->SetStakeModifier(nModifierV2);
+    std::vector<unsigned char> vchModifier = pindex->GetStakeModifierBytes();
+    BOOST_CHECK(vchModifier == std::vector<unsigned char>(nModifierV2.begin(), nModifierV2.end()));
+    BOOST_CHECK(vIndex[6]->SetStakeModifierBytes(vchModifier));
+    BOOST_CHECK(vIndex[6]->stakeModifier == nModifierV2);
+    BOOST_CHECK(!vIndex[6]->SetStakeModifierBytes(std::vector<unsigned char>(33)));
+
+    // Accumulator checkpoints live in the side table, follow copies and are
+    // dropped with their entry
+    const uint256 nCheckpoint = GetRandHash();
+    pindex->SetAccumulatorCheckpoint(nCheckpoint);
+    BOOST_CHECK(pindex->GetAccumulatorCheckpoint() == nCheckpoint);
+    BOOST_CHECK(vIndex[4]->GetAccumulatorCheckpoint().IsNull());
+    BOOST_CHECK_EQUAL(CBlockIndexAccCheckpoint::Count(), nCheckpointsBefore + 1);
+    {
+        CBlockIndex copy(*pindex);
+        BOOST_CHECK(copy.GetAccumulatorCheckpoint() == nCheckpoint);
+        BOOST_CHECK_EQUAL(CBlockIndexAccCheckpoint::Count(), nCheckpointsBefore + 2);
+    }
+    BOOST_CHECK_EQUAL(CBlockIndexAccCheckpoint::Count(), nCheckpointsBefore + 1);
+    pindex->SetAccumulatorCheckpoint(UINT256_ZERO);
+    BOOST_CHECK_EQUAL(CBlockIndexAccCheckpoint::Count(), nCheckpointsBefore);
+
+    vIndex[nEntries - 1]->SetAccumulatorCheckpoint(nCheckpoint);
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.DynamicMemoryUsage(), 0U);
+    BOOST_CHECK_EQUAL(CBlockIndexAccCheckpoint::Count(), nCheckpointsBefore);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
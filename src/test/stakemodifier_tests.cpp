@@ -0,0 +1,64 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "legacy/stakemodifier.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "test/test_tarian.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(stakemodifier_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(stakemodifier_candidate_cache)
+{
+    // A chain with irregular block times, some going back, and a mix of
+    // proof-of-work and proof-of-stake blocks
+    const int nBlocks = 500;
+    std::vector<uint256> vHash(nBlocks);
+    std::vector<CBlockIndex> vIndex(nBlocks);
+    std::vector<uint64_t> vModifier(nBlocks);
+    std::vector<bool> vGenerated(nBlocks);
+    int64_t nTime = Params().GenesisBlock().nTime;
+    for (int i = 0; i < nBlocks; i++) {
+        vHash[i] = InsecureRand256();
+        vIndex[i].phashBlock = &vHash[i];
+        vIndex[i].nHeight = i;
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        nTime += (int64_t)InsecureRandRange(150) - 30;
+        vIndex[i].nTime = nTime;
+        if (i > 100 && InsecureRandBool())
+            vIndex[i].SetProofOfStake();
+
+        // Consecutive blocks reuse the candidates of their parent
+        uint64_t nModifier;
+        bool fGenerated;
+        BOOST_CHECK(ComputeNextStakeModifier(vIndex[i].pprev, nModifier, fGenerated));
+        BOOST_CHECK(vIndex[i].SetStakeEntropyBit(vIndex[i].GetStakeEntropyBit()));
+        vIndex[i].SetStakeModifier(nModifier, fGenerated);
+        vModifier[i] = nModifier;
+        vGenerated[i] = fGenerated;
+    }
+
+    // Out of order, every computation starts from scratch and agrees
+    ClearStakeModifierCache();
+    std::vector<int> vOrder;
+    for (int i = 0; i < nBlocks; i++)
+        vOrder.push_back(i);
+    std::random_shuffle(vOrder.begin(), vOrder.end(), InsecureRandRange);
+    for (int i : vOrder) {
+        uint64_t nModifier;
+        bool fGenerated;
+        BOOST_CHECK(ComputeNextStakeModifier(vIndex[i].pprev, nModifier, fGenerated));
+        BOOST_CHECK_EQUAL(nModifier, vModifier[i]);
+        BOOST_CHECK_EQUAL(fGenerated, vGenerated[i]);
+    }
+    ClearStakeModifierCache();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,146 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "test/test_tarian.h"
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, TestingSetup)
+
+static void WriteCoins(CCoinsViewDB& coinsdb, const uint256& txid, const std::vector<CTxOut>& vout, int nHeight)
+{
+    CCoinsMap mapCoins;
+    CCoinsCacheEntry& entry = mapCoins[txid];
+    entry.coins.vout = vout;
+    entry.coins.nHeight = nHeight;
+    entry.flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(coinsdb.BatchWrite(mapCoins, Params().GetConsensus().hashGenesisBlock));
+}
+
+static bool VerifyFile(const fs::path& path, CUTXOSnapshotInfo& info)
+{
+    CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+    std::string strError;
+    return VerifyUTXOSnapshot(filein, info, strError);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    const CScript script = CScript() << OP_1;
+
+    // Two made-up blocks on top of the genesis block
+    std::vector<CBlockIndex> vIndex(3);
+    std::vector<uint256> vHash(3);
+    std::vector<const CBlockIndex*> vChain;
+    vIndex[0] = CBlockIndex(Params().GenesisBlock());
+    vHash[0] = Params().GenesisBlock().GetHash();
+    for (int i = 0; i < 3; i++) {
+        if (i > 0) {
+            CBlock block;
+            block.nVersion = 8;
+            block.hashPrevBlock = vHash[i - 1];
+            block.nTime = Params().GenesisBlock().nTime + i * 60;
+            block.nBits = Params().GenesisBlock().nBits;
+            vIndex[i] = CBlockIndex(block);
+            vIndex[i].pprev = &vIndex[i - 1];
+            vHash[i] = block.GetHash();
+        }
+        vIndex[i].nHeight = i;
+        vIndex[i].nTx = 1;
+        vIndex[i].nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+        vIndex[i].phashBlock = &vHash[i];
+        vChain.push_back(&vIndex[i]);
+    }
+
+    CCoinsViewDB coinsdb(1 << 20, true);
+    // Database order is byte order, which differs from numeric order here
+    WriteCoins(coinsdb, uint256S("0100"), {CTxOut(5 * COIN, script), CTxOut(3 * COIN, CScript() << OP_2)}, 1);
+    WriteCoins(coinsdb, uint256S("02"), {CTxOut(), CTxOut(COIN, script)}, 2);
+    CZerocoinDB zerocoindb(0, true);
+    BOOST_CHECK(zerocoindb.WriteAccChecksum(0x1234, libzerocoin::ZQ_ONE, 2));
+
+    // Write the snapshot
+    const fs::path path = GetDataDir() / "utxo.dat";
+    CUTXOSnapshotInfo info;
+    {
+        CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        boost::scoped_ptr<CCoinsViewDBCursor> pcoinsCursor(coinsdb.Cursor());
+        boost::scoped_ptr<CDBIterator> pzerocoinCursor(zerocoindb.NewIterator());
+        BOOST_CHECK(WriteUTXOSnapshot(fileout, vChain, *pcoinsCursor, *pzerocoinCursor, 42 * COIN, info));
+    }
+    BOOST_CHECK(info.metadata.hashBaseBlock == vHash[2]);
+    BOOST_CHECK_EQUAL(info.metadata.nBaseHeight, 2);
+    BOOST_CHECK_EQUAL(info.stats.nTransactions, 2U);
+    BOOST_CHECK_EQUAL(info.stats.nTransactionOutputs, 3U);
+    BOOST_CHECK_EQUAL(info.stats.nTotalAmount, 9 * COIN);
+    BOOST_CHECK_EQUAL(info.nZerocoinRecords, 1U);
+
+    // The coins hash the same way as in gettxoutsetinfo
+    CCoinsStats stats;
+    BOOST_CHECK(coinsdb.GetStats(stats));
+    BOOST_CHECK(stats.hashMuHash == info.stats.hashMuHash);
+
+    // Verification finds the same contents and checksum
+    CUTXOSnapshotInfo infoRead;
+    BOOST_CHECK(VerifyFile(path, infoRead));
+    BOOST_CHECK(infoRead.hashSnapshot == info.hashSnapshot);
+    BOOST_CHECK(infoRead.stats.hashMuHash == info.stats.hashMuHash);
+    BOOST_CHECK_EQUAL(infoRead.stats.nTransactionOutputs, 3U);
+    BOOST_CHECK_EQUAL(infoRead.nZerocoinRecords, 1U);
+    BOOST_CHECK_EQUAL(infoRead.nMoneySupply, 42 * COIN);
+
+    // Loading fills fresh databases and the block index
+    CCoinsViewDB coinsdbLoaded(1 << 20, true);
+    CZerocoinDB zerocoindbLoaded(0, true);
+    std::vector<CBlockIndex*> vLoaded;
+    {
+        LOCK(cs_main);
+        CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        std::string strError;
+        BOOST_CHECK(LoadUTXOSnapshot(filein, infoRead, coinsdbLoaded, zerocoindbLoaded, vLoaded, strError));
+    }
+    BOOST_CHECK_EQUAL(vLoaded.size(), 3U);
+    BOOST_CHECK(vLoaded.back()->GetBlockHash() == vHash[2]);
+    BOOST_CHECK(vLoaded.back()->pprev == vLoaded[1]);
+    BOOST_CHECK(vLoaded.back()->nStatus & BLOCK_ASSUMED_VALID);
+    BOOST_CHECK(!(vLoaded.back()->nStatus & BLOCK_HAVE_DATA));
+    CCoins coins;
+    BOOST_CHECK(coinsdbLoaded.GetCoins(uint256S("02"), coins));
+    BOOST_CHECK(coins.IsAvailable(1) && !coins.IsAvailable(0));
+    int nHeight;
+    BOOST_CHECK(zerocoindbLoaded.ReadAccChecksum(0x1234, libzerocoin::ZQ_ONE, nHeight));
+    BOOST_CHECK_EQUAL(nHeight, 2);
+
+    // Any changed byte is caught, as is a truncated file
+    std::vector<char> vchFile(fs::file_size(path));
+    {
+        CAutoFile filein(fsbridge::fopen(path, "rb"), SER_DISK, CLIENT_VERSION);
+        filein.read(vchFile.data(), vchFile.size());
+    }
+    for (size_t nPos : {(size_t)10, vchFile.size() / 2, vchFile.size() - 40}) {
+        std::vector<char> vchCorrupt(vchFile);
+        vchCorrupt[nPos] ^= 1;
+        {
+            CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+            fileout.write(vchCorrupt.data(), vchCorrupt.size());
+        }
+        BOOST_CHECK(!VerifyFile(path, infoRead));
+    }
+    {
+        CAutoFile fileout(fsbridge::fopen(path, "wb"), SER_DISK, CLIENT_VERSION);
+        fileout.write(vchFile.data(), vchFile.size() - 1);
+    }
+    BOOST_CHECK(!VerifyFile(path, infoRead));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -12,8 +12,49 @@
 
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
+/**
+ * Database profiles. Coins and block index records are small and read at
+ * random, so blocks stay small; larger table files keep the number of open
+ * files down as the databases grow. Snappy compression would gain little on
+ * hashes and compressed coins, so it stays off.
+ */
+static CDBOptions GetChainstateDBOptions()
+{
+    CDBOptions dbOptions;
+    dbOptions.nMaxFileSize = 32 << 20;
+    dbOptions.nMaxOpenFiles = 128;
+    dbOptions.nBulkWriteBufferSize = 64 << 20;
+    return dbOptions;
+}
+
+static CDBOptions GetBlockTreeDBOptions()
+{
+    CDBOptions dbOptions;
+    dbOptions.nMaxFileSize = 32 << 20;
+    dbOptions.nBulkWriteBufferSize = 32 << 20;
+    return dbOptions;
+}
+
+static CDBOptions GetIndexDBOptions()
+{
+    CDBOptions dbOptions;
+    dbOptions.nBlockSize = 16 << 10;
+    dbOptions.nMaxFileSize = 16 << 20;
+    dbOptions.nMaxOpenFiles = 32;
+    return dbOptions;
+}
+
+static CDBOptions GetZerocoinDBOptions()
+{
+    CDBOptions dbOptions;
+    dbOptions.nMaxFileSize = 8 << 20;
+    dbOptions.nMaxOpenFiles = 32;
+    return dbOptions;
+}
+
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
@@ -24,36 +65,57 @@ static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
 static const char DB_MONEY_SUPPLY = 'M';
+static const char DB_VERIFY_PROGRESS = 'V';
 
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe)
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, GetChainstateDBOptions()),
+                                                                            fFlushPending(false), fFlushThread(false), fFlushOk(true)
 {
 }
 
 bool CCoinsViewDB::GetCoins(const uint256& txid, CCoins& coins) const
 {
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        CCoinsMap::const_iterator it = mapFlushing.find(txid);
+        if (it != mapFlushing.end()) {
+            coins = it->second.coins;
+            return !coins.IsPruned();
+        }
+    }
     return db.Read(std::make_pair(DB_COINS, txid), coins);
 }
 
 bool CCoinsViewDB::HaveCoins(const uint256& txid) const
 {
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        CCoinsMap::const_iterator it = mapFlushing.find(txid);
+        if (it != mapFlushing.end())
+            return !it->second.coins.IsPruned();
+    }
     return db.Exists(std::make_pair(DB_COINS, txid));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const
 {
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        if (fFlushPending && !hashBlockFlushing.IsNull())
+            return hashBlockFlushing;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return UINT256_ZERO;
     return hashBestChain;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+bool CCoinsViewDB::WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock)
 {
     CDBBatch batch;
     size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
             if (it->second.coins.IsPruned())
                 batch.Erase(std::make_pair(DB_COINS, it->first));
@@ -62,8 +124,6 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
@@ -72,7 +132,113 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
+bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    if (!fFlushThread) {
+        if (!fFlushOk)
+            return false;
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        size_t nEntries = mapCoins.size();
+        bool fOk = WriteCoins(mapCoins, hashBlock);
+        mapCoins.clear();
+        lock.lock();
+        flushStats.nFlushes++;
+        flushStats.nLastEntries = nEntries;
+        flushStats.nLastDuration = GetTimeMicros() - nStart;
+        flushStats.nTotalDuration += flushStats.nLastDuration;
+        return fOk;
+    }
+
+    // One batch in flight at a time; validation stalls here only if the
+    // previous one is still being written.
+    int64_t nStart = GetTimeMicros();
+    while (fFlushPending)
+        condFlush.wait(lock);
+    flushStats.nLastStall = GetTimeMicros() - nStart;
+    flushStats.nTotalStall += flushStats.nLastStall;
+    if (flushStats.nLastStall >= 1000)
+        LogPrint(BCLog::COINDB, "Waited %dms for the previous write to the coin database\n", flushStats.nLastStall / 1000);
+    if (!fFlushOk)
+        return false;
+
+    mapFlushing.swap(mapCoins);
+    mapCoins.clear();
+    hashBlockFlushing = hashBlock;
+    fFlushPending = true;
+    flushStats.fInProgress = true;
+    condFlush.notify_all();
+    return true;
+}
+
+void CCoinsViewDB::ThreadFlush()
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    fFlushThread = true;
+    try {
+        while (true) {
+            while (!fFlushPending)
+                condFlush.wait(lock);
+
+            // mapFlushing stays unchanged until fFlushPending is reset, so
+            // it can be written while reads look into it.
+            lock.unlock();
+            int64_t nStart = GetTimeMicros();
+            bool fOk;
+            try {
+                fOk = WriteCoins(mapFlushing, hashBlockFlushing);
+            } catch (const std::exception& e) {
+                fOk = error("%s : %s", __func__, e.what());
+            }
+            int64_t nDuration = GetTimeMicros() - nStart;
+            LogPrint(BCLog::COINDB, "Wrote %u entries to the coin database in the background in %dms\n", mapFlushing.size(), nDuration / 1000);
+
+            // Free the entries outside the lock, it takes a while for large caches
+            CCoinsMap mapWritten;
+            lock.lock();
+            mapWritten.swap(mapFlushing);
+            fFlushOk = fFlushOk && fOk;
+            fFlushPending = false;
+            flushStats.fInProgress = false;
+            flushStats.nFlushes++;
+            flushStats.nLastEntries = mapWritten.size();
+            flushStats.nLastDuration = nDuration;
+            flushStats.nTotalDuration += nDuration;
+            condFlush.notify_all();
+            lock.unlock();
+            mapWritten.clear();
+            lock.lock();
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Interrupted while waiting: a batch handed over meanwhile is written here
+        fFlushThread = false;
+        if (fFlushPending) {
+            fFlushOk = fFlushOk && WriteCoins(mapFlushing, hashBlockFlushing);
+            mapFlushing.clear();
+            fFlushPending = false;
+            flushStats.fInProgress = false;
+        }
+        condFlush.notify_all();
+        throw;
+    }
+}
+
+bool CCoinsViewDB::WaitFlushed() const
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    while (fFlushPending)
+        condFlush.wait(lock);
+    return fFlushOk;
+}
+
+CCoinsFlushStats CCoinsViewDB::GetFlushStats() const
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    return flushStats;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, GetBlockTreeDBOptions())
 {
 }
 
@@ -107,6 +273,7 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
 
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
+    WaitFlushed();
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
@@ -114,6 +281,7 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
     pcursor->Seek(DB_COINS);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    MuHash3072 muhash;
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
     CAmount nTotalAmount = 0;
@@ -131,6 +299,8 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
                         ss << VARINT(i + 1);
                         ss << out;
                         nTotalAmount += out.nValue;
+                        ApplyCoinToMuHash(muhash, COutPoint(key.second, i), out, false);
+                        stats.nBogoSize += GetBogoSize(out.scriptPubKey);
                     }
                 }
                 stats.nSerializedSize += 32 + pcursor->GetValueSize();
@@ -146,10 +316,54 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 
     stats.nHeight = WITH_LOCK(cs_main, return mapBlockIndex.find(stats.hashBlock)->second->nHeight;);
     stats.hashSerialized = ss.GetHash();
+    muhash.Finalize(stats.hashMuHash);
     stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
+CCoinsViewDBCursor* CCoinsViewDB::Cursor() const
+{
+    WaitFlushed();
+    // Same const-cast as in GetStats, the iterator only reads
+    CCoinsViewDBCursor* pcursor = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator());
+    pcursor->pcursor->Seek(DB_COINS);
+    // Cache the key of the first record, so Valid() and GetKey() need no further parsing
+    if (!pcursor->pcursor->Valid() || !pcursor->pcursor->GetKey(pcursor->keyTmp))
+        pcursor->keyTmp.first = 0;
+    return pcursor;
+}
+
+CCoinsViewDBCursor::CCoinsViewDBCursor(CDBIterator* pcursorIn) : pcursor(pcursorIn)
+{
+    keyTmp.first = 0;
+}
+
+bool CCoinsViewDBCursor::Valid() const
+{
+    return keyTmp.first == DB_COINS;
+}
+
+void CCoinsViewDBCursor::Next()
+{
+    pcursor->Next();
+    if (!pcursor->Valid() || !pcursor->GetKey(keyTmp))
+        keyTmp.first = 0; // Invalidate cached key after last record so that Valid() and GetKey() return false
+}
+
+bool CCoinsViewDBCursor::GetKey(uint256& txid) const
+{
+    if (keyTmp.first == DB_COINS) {
+        txid = keyTmp.second;
+        return true;
+    }
+    return false;
+}
+
+bool CCoinsViewDBCursor::GetValue(CCoins& coins) const
+{
+    return pcursor->GetValue(coins);
+}
+
 bool CBlockTreeDB::WriteMoneySupply(const int64_t& nSupply)
 {
     return Write(DB_MONEY_SUPPLY, nSupply);
@@ -209,55 +423,175 @@ bool CBlockTreeDB::ReadInt(const std::string& name, int& nValue)
     return Read(std::make_pair('I', name), nValue);
 }
 
+bool CBlockTreeDB::WriteVerifyProgress(const CVerifyDBProgress& progress)
+{
+    return Write(DB_VERIFY_PROGRESS, progress);
+}
+
+bool CBlockTreeDB::ReadVerifyProgress(CVerifyDBProgress& progress)
+{
+    return Read(DB_VERIFY_PROGRESS, progress);
+}
+
+bool CBlockTreeDB::EraseVerifyProgress()
+{
+    return Erase(DB_VERIFY_PROGRESS);
+}
+
+namespace {
+
+/** A block index record on its way from the database into mapBlockIndex */
+struct CBlockIndexRecord
+{
+    enum Result { OK, READ_FAILED, HASH_MISMATCH, POW_FAILED };
+
+    uint256 hashKey;
+    std::vector<char> vchValue;
+    CDiskBlockIndex diskindex;
+    Result result;
+    bool fUpgrade; //! read from a record without its hash, to be rewritten
+
+    CBlockIndexRecord() : result(OK), fUpgrade(false) {}
+};
+
+} // anon namespace
+
+/** Number of block index records read from the cursor before they are parsed */
+static const size_t BLOCK_INDEX_LOAD_BATCH = 50000;
+
+/** Upper bound on the threads used to parse block index records */
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 16;
+
+/**
+ * Deserialize records [nBegin, nEnd). Records that predate the stored hash
+ * get it computed here, along with the proof of work check of pre-PoS blocks;
+ * for the others it was done before the record was written.
+ */
+static void ParseBlockIndexRecords(std::vector<CBlockIndexRecord>* pvRecords, size_t nBegin, size_t nEnd)
+{
+    const Consensus::Params& consensus = Params().GetConsensus();
+    for (size_t i = nBegin; i < nEnd; i++) {
+        CBlockIndexRecord& record = (*pvRecords)[i];
+        try {
+            CDataStream ssValue(record.vchValue.data(), record.vchValue.data() + record.vchValue.size(), SER_DISK, CLIENT_VERSION);
+            ssValue >> record.diskindex;
+        } catch (const std::exception&) {
+            record.result = CBlockIndexRecord::READ_FAILED;
+            continue;
+        }
+        std::vector<char>().swap(record.vchValue);
+
+        CDiskBlockIndex& diskindex = record.diskindex;
+        if (diskindex.HasStoredHash()) {
+            if (diskindex.hashBlock != record.hashKey)
+                record.result = CBlockIndexRecord::HASH_MISMATCH;
+            continue;
+        }
+
+        diskindex.hashBlock = diskindex.ComputeBlockHash();
+        record.fUpgrade = true;
+        if (!consensus.NetworkUpgradeActive(diskindex.nHeight, Consensus::UPGRADE_POS)) {
+            if (!CheckProofOfWork(diskindex.hashBlock, diskindex.nBits))
+                record.result = CBlockIndexRecord::POW_FAILED;
+        }
+    }
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(std::make_pair(DB_BLOCK_INDEX, UINT256_ZERO));
 
-    // Load mapBlockIndex
-    while (pcursor->Valid()) {
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    std::vector<CBlockIndexRecord> vRecords;
+    std::vector<const CBlockIndex*> vUpgrade;
+    bool fCursorDone = false;
+
+    // Load mapBlockIndex. The cursor is read sequentially in batches, each
+    // batch is parsed across threads and then linked into the map in order.
+    while (!fCursorDone) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight = diskindex.nHeight;
-                pindexNew->nFile = diskindex.nFile;
-                pindexNew->nDataPos = diskindex.nDataPos;
-                pindexNew->nUndoPos = diskindex.nUndoPos;
-                pindexNew->nVersion = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime = diskindex.nTime;
-                pindexNew->nBits = diskindex.nBits;
-                pindexNew->nNonce = diskindex.nNonce;
-                pindexNew->nStatus = diskindex.nStatus;
-                pindexNew->nTx = diskindex.nTx;
-
-                //zerocoin
-                pindexNew->nAccumulatorCheckpoint = diskindex.nAccumulatorCheckpoint;
-
-                //Proof Of Stake
-                pindexNew->nFlags = diskindex.nFlags;
-                pindexNew->vStakeModifier = diskindex.vStakeModifier;
-
-                if (!Params().GetConsensus().NetworkUpgradeActive(pindexNew->nHeight, Consensus::UPGRADE_POS)) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
-                }
+        vRecords.clear();
+        while (vRecords.size() < BLOCK_INDEX_LOAD_BATCH) {
+            std::pair<char, uint256> key;
+            if (!pcursor->Valid() || !pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX) {
+                fCursorDone = true;
+                break;
+            }
+            vRecords.emplace_back();
+            vRecords.back().hashKey = key.second;
+            pcursor->GetValueBytes(vRecords.back().vchValue);
+            pcursor->Next();
+        }
 
-                pcursor->Next();
-            } else {
+        const size_t nChunk = (vRecords.size() + nThreads - 1) / nThreads;
+        if (nThreads == 1 || vRecords.size() < 2 * (size_t)nThreads) {
+            ParseBlockIndexRecords(&vRecords, 0, vRecords.size());
+        } else {
+            boost::thread_group threads;
+            for (size_t nBegin = 0; nBegin < vRecords.size(); nBegin += nChunk)
+                threads.create_thread(boost::bind(&ParseBlockIndexRecords, &vRecords, nBegin, std::min(nBegin + nChunk, vRecords.size())));
+            threads.join_all();
+        }
+
+        for (const CBlockIndexRecord& record : vRecords) {
+            const CDiskBlockIndex& diskindex = record.diskindex;
+            switch (record.result) {
+            case CBlockIndexRecord::OK:
+                break;
+            case CBlockIndexRecord::READ_FAILED:
                 return error("%s : failed to read value", __func__);
+            case CBlockIndexRecord::HASH_MISMATCH:
+                return error("%s : stored hash %s does not match key %s", __func__, diskindex.hashBlock.ToString(), record.hashKey.ToString());
+            case CBlockIndexRecord::POW_FAILED:
+                return error("LoadBlockIndex() : CheckProofOfWork failed: %s", diskindex.ToString());
             }
-        } else {
-            break;
+
+            // Construct block index object
+            CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
+            pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight = diskindex.nHeight;
+            pindexNew->nFile = diskindex.nFile;
+            pindexNew->nDataPos = diskindex.nDataPos;
+            pindexNew->nUndoPos = diskindex.nUndoPos;
+            pindexNew->nVersion = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime = diskindex.nTime;
+            pindexNew->nBits = diskindex.nBits;
+            pindexNew->nNonce = diskindex.nNonce;
+            pindexNew->nStatus = diskindex.nStatus;
+            pindexNew->nTx = diskindex.nTx;
+
+            //zerocoin
+            pindexNew->SetAccumulatorCheckpoint(diskindex.GetAccumulatorCheckpoint());
+
+            //Proof Of Stake
+            pindexNew->nFlags = diskindex.nFlags;
+            pindexNew->stakeModifier = diskindex.stakeModifier;
+            pindexNew->nStakeModifierSize = diskindex.nStakeModifierSize;
+
+            if (record.fUpgrade)
+                vUpgrade.push_back(pindexNew);
         }
     }
 
+    // Rewrite records that predate the stored hash, so that their hash and
+    // proof of work are not computed again on the next start
+    if (!vUpgrade.empty()) {
+        LogPrintf("%s: upgrading %u block index records to store their hash\n", __func__, vUpgrade.size());
+        for (size_t nBegin = 0; nBegin < vUpgrade.size(); nBegin += BLOCK_INDEX_LOAD_BATCH) {
+            CDBBatch batch;
+            const size_t nEnd = std::min(nBegin + BLOCK_INDEX_LOAD_BATCH, vUpgrade.size());
+            for (size_t i = nBegin; i < nEnd; i++)
+                batch.Write(std::make_pair(DB_BLOCK_INDEX, vUpgrade[i]->GetBlockHash()), CDiskBlockIndex(vUpgrade[i]));
+            if (!WriteBatch(batch))
+                return error("%s : failed to upgrade block index records", __func__);
+        }
+        if (!Sync())
+            return error("%s : failed to sync upgraded block index records", __func__);
+    }
+
     return true;
 }
 
@@ -266,7 +600,7 @@ bool CBlockTreeDB::ReadLegacyBlockIndex(const uint256& blockHash, CLegacyBlockIn
     return Read(std::make_pair(DB_BLOCK_INDEX, blockHash), biRet);
 }
 
-CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe)
+CZerocoinDB::CZerocoinDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "zerocoin", nCacheSize, fMemory, fWipe, GetZerocoinDBOptions())
 {
 }
 
@@ -295,6 +629,31 @@ bool CZerocoinDB::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
     return Read(std::make_pair('m', hashPubcoin), hashTx);
 }
 
+bool CZerocoinDB::ReadCoinMints(const std::vector<uint256>& vHashPubcoin, std::map<uint256, uint256>& mapHashTx)
+{
+    // Keys are compared bytewise, so seeking in that order only ever moves the cursor forward
+    std::vector<uint256> vSorted(vHashPubcoin);
+    std::sort(vSorted.begin(), vSorted.end(), [](const uint256& a, const uint256& b) {
+        return memcmp(a.begin(), b.begin(), a.size()) < 0;
+    });
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    for (const uint256& hashPubcoin : vSorted) {
+        pcursor->Seek(std::make_pair('m', hashPubcoin));
+        if (!pcursor->Valid())
+            break;
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != 'm' || key.second != hashPubcoin)
+            continue;
+        uint256 hashTx;
+        if (!pcursor->GetValue(hashTx))
+            return error("%s : failed to read value", __func__);
+        mapHashTx[hashPubcoin] = hashTx;
+    }
+
+    return true;
+}
+
 bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
 {
     uint256 hash = GetPubCoinHash(bnPubcoin);
@@ -435,3 +794,61 @@ bool CZerocoinDB::WipeAccChecksums()
     LogPrintf("%s: AccChecksum database removed.\n", __func__);
     return true;
 }
+
+// Compact block filter index
+static const char DB_FILTER = 'f';
+static const char DB_FILTER_HEADER = 'h';
+
+CBlockFilterDB::CBlockFilterDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blockfilter", nCacheSize, fMemory, fWipe, GetIndexDBOptions())
+{
+}
+
+bool CBlockFilterDB::WriteFilter(const BlockFilter& filter, const uint256& filterHeader)
+{
+    const uint8_t nType = static_cast<uint8_t>(filter.GetFilterType());
+    const auto key = std::make_pair(nType, filter.GetBlockHash());
+    CDBBatch batch;
+    batch.Write(std::make_pair(DB_FILTER, key), filter.GetEncodedFilter());
+    batch.Write(std::make_pair(DB_FILTER_HEADER, key), std::make_pair(filter.GetHash(), filterHeader));
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterDB::ReadFilter(BlockFilterType filterType, const uint256& blockHash, BlockFilter& filter) const
+{
+    std::vector<unsigned char> vEncoded;
+    if (!Read(std::make_pair(DB_FILTER, std::make_pair(static_cast<uint8_t>(filterType), blockHash)), vEncoded))
+        return false;
+    try {
+        filter = BlockFilter(filterType, blockHash, vEncoded);
+    } catch (const std::exception& e) {
+        return error("%s : invalid filter for block %s: %s", __func__, blockHash.GetHex(), e.what());
+    }
+    return true;
+}
+
+bool CBlockFilterDB::ReadFilterHashAndHeader(BlockFilterType filterType, const uint256& blockHash, uint256& filterHash, uint256& filterHeader) const
+{
+    std::pair<uint256, uint256> value;
+    if (!Read(std::make_pair(DB_FILTER_HEADER, std::make_pair(static_cast<uint8_t>(filterType), blockHash)), value))
+        return false;
+    filterHash = value.first;
+    filterHeader = value.second;
+    return true;
+}
+
+// UTXO set statistics index
+static const char DB_COIN_STATS = 's';
+
+CCoinStatsDB::CCoinStatsDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "coinstats", nCacheSize, fMemory, fWipe, GetIndexDBOptions())
+{
+}
+
+bool CCoinStatsDB::WriteStats(const uint256& blockHash, const CCoinStatsEntry& entry)
+{
+    return Write(std::make_pair(DB_COIN_STATS, blockHash), entry);
+}
+
+bool CCoinStatsDB::ReadStats(const uint256& blockHash, CCoinStatsEntry& entry) const
+{
+    return Read(std::make_pair(DB_COIN_STATS, blockHash), entry);
+}
@@ -7,6 +7,8 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "blockfilter.h"
+#include "coinstats.h"
 #include "dbwrapper.h"
 #include "main.h"
 #include "ztarn/zerocoin.h"
@@ -16,6 +18,10 @@
 #include <utility>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
 class CCoins;
 class uint256;
 
@@ -54,12 +60,49 @@ struct CDiskTxPos : public CDiskBlockPos {
     }
 };
 
-/** CCoinsView backed by the LevelDB coin database (chainstate/) */
+class CCoinsViewDBCursor;
+
+/** Timings of the writes of the coin database */
+struct CCoinsFlushStats {
+    uint64_t nFlushes;
+    //! a write is running in the background
+    bool fInProgress;
+    size_t nLastEntries;
+    int64_t nLastDuration;
+    int64_t nTotalDuration;
+    //! time BatchWrite waited for the previous write to finish
+    int64_t nLastStall;
+    int64_t nTotalStall;
+
+    CCoinsFlushStats() : nFlushes(0), fInProgress(false), nLastEntries(0), nLastDuration(0), nTotalDuration(0), nLastStall(0), nTotalStall(0) {}
+};
+
+/**
+ * CCoinsView backed by the LevelDB coin database (chainstate/).
+ *
+ * While ThreadFlush runs, BatchWrite takes over the entries it is given and
+ * returns, so the cache above starts afresh while they are written in the
+ * background. Until then reads are answered from them. Only one batch is in
+ * flight at a time: BatchWrite waits for the previous one to be written.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
 
+    mutable boost::mutex csFlush;
+    mutable boost::condition_variable condFlush;
+    //! Entries handed over by BatchWrite, read-only until written
+    CCoinsMap mapFlushing;
+    uint256 hashBlockFlushing;
+    bool fFlushPending;
+    bool fFlushThread;
+    //! whether the last background write succeeded
+    bool fFlushOk;
+    CCoinsFlushStats flushStats;
+
+    bool WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock);
+
 public:
     CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
 
@@ -68,6 +111,40 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+    /** Cursor over the unspent transactions in txid order, reading from an implicit snapshot of the database */
+    CCoinsViewDBCursor* Cursor() const;
+
+    /** Write the batches handed over by BatchWrite, until interrupted */
+    void ThreadFlush();
+    /** Wait until the batch handed over last is written. Returns whether writing it succeeded. */
+    bool WaitFlushed() const;
+    CCoinsFlushStats GetFlushStats() const;
+
+    void SetBulkLoad(bool fBulkLoad)
+    {
+        WaitFlushed();
+        db.SetBulkLoad(fBulkLoad);
+    }
+    void Compact() { db.Compact(); }
+    void GetDBStats(CDBStats& stats) const { db.GetStats(stats); }
+};
+
+/** Iterates over the unspent transactions of a CCoinsViewDB */
+class CCoinsViewDBCursor
+{
+public:
+    bool Valid() const;
+    void Next();
+    bool GetKey(uint256& txid) const;
+    bool GetValue(CCoins& coins) const;
+
+private:
+    CCoinsViewDBCursor(CDBIterator* pcursorIn);
+
+    boost::scoped_ptr<CDBIterator> pcursor;
+    std::pair<char, uint256> keyTmp;
+
+    friend class CCoinsViewDB;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -93,6 +170,9 @@ public:
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
     bool ReadInt(const std::string& name, int& nValue);
+    bool WriteVerifyProgress(const CVerifyDBProgress& progress);
+    bool ReadVerifyProgress(CVerifyDBProgress& progress);
+    bool EraseVerifyProgress();
     bool LoadBlockIndexGuts();
     bool ReadLegacyBlockIndex(const uint256& blockHash, CLegacyBlockIndex& biRet);
     bool WriteMoneySupply(const int64_t& nSupply);
@@ -114,6 +194,8 @@ public:
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
     bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
+    /** Look up several mints through one cursor, in key order; mapHashTx receives the ones found */
+    bool ReadCoinMints(const std::vector<uint256>& vHashPubcoin, std::map<uint256, uint256>& mapHashTx);
     /** Write zTARN spends to the zerocoinDB in a batch */
     bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo);
     bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
@@ -132,4 +214,38 @@ public:
     bool WipeAccChecksums();
 };
 
+/** Compact block filter index (blockfilter/) */
+class CBlockFilterDB : public CDBWrapper
+{
+public:
+    CBlockFilterDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CBlockFilterDB(const CBlockFilterDB&);
+    void operator=(const CBlockFilterDB&);
+
+public:
+    /** Store the filter of a connected block along with its filter header (chained to the parent's) */
+    bool WriteFilter(const BlockFilter& filter, const uint256& filterHeader);
+    bool ReadFilter(BlockFilterType filterType, const uint256& blockHash, BlockFilter& filter) const;
+    /** Read the [filter hash, filter header] pair stored for a block */
+    bool ReadFilterHashAndHeader(BlockFilterType filterType, const uint256& blockHash, uint256& filterHash, uint256& filterHeader) const;
+};
+
+/** UTXO set statistics index (coinstats/) */
+class CCoinStatsDB : public CDBWrapper
+{
+public:
+    CCoinStatsDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CCoinStatsDB(const CCoinStatsDB&);
+    void operator=(const CCoinStatsDB&);
+
+public:
+    /** Store the UTXO set statistics as of a connected block */
+    bool WriteStats(const uint256& blockHash, const CCoinStatsEntry& entry);
+    bool ReadStats(const uint256& blockHash, CCoinStatsEntry& entry) const;
+};
+
 #endif // BITCOIN_TXDB_H
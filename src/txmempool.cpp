@@ -21,7 +21,8 @@
 CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
                                  int64_t _nTime, double _dPriority,
                                  unsigned int _nHeight, bool poolHasNoInputsOf, CAmount _inChainInputValue) :
-     tx(_tx), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight), hadNoDependencies(poolHasNoInputsOf)
+     tx(_tx), nFee(_nFee), nTime(_nTime), dPriority(_dPriority), nHeight(_nHeight), hadNoDependencies(poolHasNoInputsOf),
+     inChainInputValue(_inChainInputValue), nEpochMarker(0)
 {
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
     nModSize = tx.CalculateModifiedSize(nTxSize);
@@ -31,6 +32,10 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nCountWithDescendants = 1;
     nSizeWithDescendants = nTxSize;
     nFeesWithDescendants = nFee;
+
+    nCountWithAncestors = 1;
+    nSizeWithAncestors = nTxSize;
+    nFeesWithAncestors = nFee;
     CAmount nValueIn = tx.GetValueOut()+nFee;
     assert(inChainInputValue <= nValueIn);
 }
@@ -51,65 +56,66 @@ CTxMemPoolEntry::GetPriority(unsigned int currentHeight) const
     return dResult;
 }
 
-// Update the given tx for any in-mempool descendants.
+// Update the given tx for any in-mempool descendants, and those descendants
+// for the given tx as a new ancestor.
 // Assumes that setMemPoolChildren is correct for the given tx and all
 // descendants.
 bool CTxMemPool::UpdateForDescendants(txiter updateIt, int maxDescendantsToVisit, cacheMap &cachedDescendants, const std::set<uint256> &setExclude)
 {
-    // Track the number of entries (outside setExclude) that we'd need to visit
-    // (will bail out if it exceeds maxDescendantsToVisit)
-    int nChildrenToVisit = 0;
-
-    setEntries stageEntries, setAllDescendants;
-    stageEntries = GetMemPoolChildren(updateIt);
-
-    while (!stageEntries.empty()) {
-        const txiter cit = *stageEntries.begin();
-        if (cit->IsDirty()) {
-            // Don't consider any more children if any descendant is dirty
-            return false;
+    std::vector<txiter> vStage, vAllDescendants;
+    bool fDirtyDescendant = false;
+    {
+        EpochGuard epoch(*this);
+        visited(updateIt);
+        for (const txiter& childEntry : GetMemPoolChildren(updateIt)) {
+            if (!visited(childEntry)) vStage.push_back(childEntry);
         }
-        setAllDescendants.insert(cit);
-        stageEntries.erase(cit);
-        const setEntries &setChildren = GetMemPoolChildren(cit);
-        for (const txiter& childEntry : setChildren) {
-            cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
-            if (cacheIt != cachedDescendants.end()) {
-                // We've already calculated this one, just add the entries for this set
-                // but don't traverse again.
-                for (const txiter& cacheEntry : cacheIt->second) {
-                    // update visit count only for new child transactions
-                    // (outside of setExclude and stageEntries)
-                    if (setAllDescendants.insert(cacheEntry).second &&
-                            !setExclude.count(cacheEntry->GetTx().GetHash()) &&
-                            !stageEntries.count(cacheEntry)) {
-                        nChildrenToVisit++;
+
+        // The walk is not cut short: the ancestor state of every descendant
+        // must account for updateIt, even if its own descendant state is not
+        // going to be updated.
+        while (!vStage.empty()) {
+            const txiter cit = vStage.back();
+            vStage.pop_back();
+            fDirtyDescendant |= cit->IsDirty();
+            vAllDescendants.push_back(cit);
+            const setEntries &setChildren = GetMemPoolChildren(cit);
+            for (const txiter& childEntry : setChildren) {
+                cacheMap::iterator cacheIt = cachedDescendants.find(childEntry);
+                if (cacheIt != cachedDescendants.end()) {
+                    // We've already calculated this one, just add the entries for this set
+                    // but don't traverse again.
+                    for (const txiter& cacheEntry : cacheIt->second) {
+                        if (!visited(cacheEntry)) vAllDescendants.push_back(cacheEntry);
                     }
+                } else if (!visited(childEntry)) {
+                    // Schedule for later processing
+                    vStage.push_back(childEntry);
                 }
-            } else if (!setAllDescendants.count(childEntry)) {
-                // Schedule for later processing and update our visit count
-                if (stageEntries.insert(childEntry).second && !setExclude.count(childEntry->GetTx().GetHash())) {
-                        nChildrenToVisit++;
-                }
-            }
-            if (nChildrenToVisit > maxDescendantsToVisit) {
-                return false;
             }
         }
     }
-    // setAllDescendants now contains all in-mempool descendants of updateIt.
+    // vAllDescendants now contains all in-mempool descendants of updateIt.
     // Update and add to cached descendant map
     int64_t modifySize = 0;
     CAmount modifyFee = 0;
     int64_t modifyCount = 0;
-    for (const txiter& cit : setAllDescendants) {
+    for (const txiter& cit : vAllDescendants) {
         if (!setExclude.count(cit->GetTx().GetHash())) {
             modifySize += cit->GetTxSize();
             modifyFee += cit->GetFee();
             modifyCount++;
             cachedDescendants[updateIt].insert(cit);
+            // Descendants in setExclude were added after updateIt and already
+            // counted it as an ancestor.
+            mapTx.modify(cit, update_ancestor_state(updateIt->GetTxSize(), updateIt->GetFee(), 1));
         }
     }
+    // Don't consider any more children if any descendant is dirty, and bound
+    // the number of entries a single transaction may account for.
+    if (fDirtyDescendant || modifyCount > maxDescendantsToVisit) {
+        return false;
+    }
     mapTx.modify(updateIt, update_descendant_state(modifySize, modifyFee, modifyCount));
     return true;
 }
@@ -164,11 +170,13 @@ void CTxMemPool::UpdateTransactionsFromBlock(const std::vector<uint256> &vHashes
     }
 }
 
-bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString)
+bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString) const
 {
-    setEntries parentHashes;
+    std::vector<txiter> vStage;
     const CTransaction &tx = entry.GetTx();
 
+    EpochGuard epoch(*this);
+
     // Get parents of this transaction that are in the mempool
     // Entry may or may not already be in the mempool, and GetMemPoolParents()
     // is only valid for entries in the mempool, so we iterate mapTx to find
@@ -177,22 +185,32 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
     // tx.vin when called on entries not already in the mempool.
     for (unsigned int i = 0; i < tx.vin.size(); i++) {
         txiter piter = mapTx.find(tx.vin[i].prevout.hash);
-        if (piter != mapTx.end()) {
-            parentHashes.insert(piter);
-            if (parentHashes.size() + 1 > limitAncestorCount) {
+        if (piter != mapTx.end() && !visited(piter)) {
+            vStage.push_back(piter);
+            if (vStage.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed parents [limit: %u]", limitAncestorCount);
                 return false;
             }
+            // The ancestors of a parent are ancestors of entry as well, so
+            // its ancestor state is a lower bound we can reject on without
+            // walking the graph.
+            if (piter->GetCountWithAncestors() + 1 > limitAncestorCount) {
+                errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
+                return false;
+            } else if (piter->GetSizeWithAncestors() + entry.GetTxSize() > limitAncestorSize) {
+                errString = strprintf("exceeds ancestor size limit [limit: %u]", limitAncestorSize);
+                return false;
+            }
         }
     }
 
     size_t totalSizeWithAncestors = entry.GetTxSize();
 
-    while (!parentHashes.empty()) {
-        txiter stageit = *parentHashes.begin();
+    while (!vStage.empty()) {
+        txiter stageit = vStage.back();
+        vStage.pop_back();
 
         setAncestors.insert(stageit);
-        parentHashes.erase(stageit);
         totalSizeWithAncestors += stageit->GetTxSize();
 
         if (stageit->GetSizeWithDescendants() + entry.GetTxSize() > limitDescendantSize) {
@@ -209,10 +227,10 @@ bool CTxMemPool::CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntr
         const setEntries & setMemPoolParents = GetMemPoolParents(stageit);
         for (const txiter& phash : setMemPoolParents) {
             // If this is a new ancestor, add it.
-            if (setAncestors.count(phash) == 0) {
-                parentHashes.insert(phash);
+            if (!visited(phash)) {
+                vStage.push_back(phash);
             }
-            if (parentHashes.size() + setAncestors.size() + 1 > limitAncestorCount) {
+            if (vStage.size() + setAncestors.size() + 1 > limitAncestorCount) {
                 errString = strprintf("too many unconfirmed ancestors [limit: %u]", limitAncestorCount);
                 return false;
             }
@@ -237,6 +255,18 @@ void CTxMemPool::UpdateAncestorsOf(bool add, txiter it, setEntries &setAncestors
     }
 }
 
+void CTxMemPool::UpdateEntryForAncestors(txiter it, const setEntries &setAncestors)
+{
+    int64_t updateCount = setAncestors.size();
+    int64_t updateSize = 0;
+    CAmount updateFee = 0;
+    for (const txiter& ancestorIt : setAncestors) {
+        updateSize += ancestorIt->GetTxSize();
+        updateFee += ancestorIt->GetFee();
+    }
+    mapTx.modify(it, update_ancestor_state(updateSize, updateFee, updateCount));
+}
+
 void CTxMemPool::UpdateChildrenForRemoval(txiter it)
 {
     const setEntries &setMemPoolChildren = GetMemPoolChildren(it);
@@ -245,27 +275,58 @@ void CTxMemPool::UpdateChildrenForRemoval(txiter it)
     }
 }
 
-void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove)
+void CTxMemPool::SumRelativeDeltas(const setEntries &entries, bool fAncestors, const setEntries &entriesToSkip, deltaMap &mapDeltas)
+{
+    std::vector<txiter> vStage;
+    for (const txiter& it : entries) {
+        EpochGuard epoch(*this);
+        visited(it);
+        vStage.push_back(it);
+        while (!vStage.empty()) {
+            const txiter stageit = vStage.back();
+            vStage.pop_back();
+            const setEntries &setRelatives = fAncestors ? GetMemPoolParents(stageit) : GetMemPoolChildren(stageit);
+            for (const txiter& relative : setRelatives) {
+                if (visited(relative)) continue;
+                // Keep walking through skipped entries, as relatives further
+                // away may still need the update.
+                vStage.push_back(relative);
+                if (entriesToSkip.count(relative)) continue;
+                StateDelta& delta = mapDeltas[relative];
+                delta.nSize -= it->GetTxSize();
+                delta.nFee -= it->GetFee();
+                delta.nCount--;
+            }
+        }
+    }
+}
+
+void CTxMemPool::UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants)
 {
     // For each entry, walk back all ancestors and decrement size associated with this
-    // transaction
-    const uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
-    for (const txiter& removeIt : entriesToRemove) {
-        setEntries setAncestors;
-        const CTxMemPoolEntry &entry = *removeIt;
-        std::string dummy;
-        CalculateMemPoolAncestors(entry, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy);
-        // Note that UpdateAncestorsOf severs the child links that point to
-        // removeIt in the entries for the parents of removeIt.  This is
-        // fine since we don't need to use the mempool children of any entries
-        // to walk back over our ancestors (but we do need the mempool
-        // parents!)
-        UpdateAncestorsOf(false, removeIt, setAncestors);
-    }
-    // After updating all the ancestor sizes, we can now sever the link between each
-    // transaction being removed and any mempool children (ie, update setMemPoolParents
-    // for each direct child of a transaction being removed).
+    // transaction. Ancestors that are being removed as well need no update,
+    // and the decrements are summed per ancestor so that each one is modified
+    // (and re-sorted in mapTx) only once.
+    deltaMap mapAncestorDeltas;
+    SumRelativeDeltas(entriesToRemove, true, entriesToRemove, mapAncestorDeltas);
+    for (const deltaMap::value_type& delta : mapAncestorDeltas) {
+        mapTx.modify(delta.first, update_descendant_state(delta.second.nSize, delta.second.nFee, delta.second.nCount));
+    }
+    if (updateDescendants) {
+        // Descendants that stay in the mempool no longer have the removed
+        // transactions as ancestors.
+        deltaMap mapDescendantDeltas;
+        SumRelativeDeltas(entriesToRemove, false, entriesToRemove, mapDescendantDeltas);
+        for (const deltaMap::value_type& delta : mapDescendantDeltas) {
+            mapTx.modify(delta.first, update_ancestor_state(delta.second.nSize, delta.second.nFee, delta.second.nCount));
+        }
+    }
+    // Now that all the state is updated we can sever the links between the
+    // transactions being removed and their in-mempool parents and children.
     for (const txiter& removeIt : entriesToRemove) {
+        for (const txiter& piter : GetMemPoolParents(removeIt)) {
+            UpdateChild(piter, removeIt, false);
+        }
         UpdateChildrenForRemoval(removeIt);
     }
 }
@@ -289,8 +350,38 @@ void CTxMemPoolEntry::UpdateState(int64_t modifySize, CAmount modifyFee, int64_t
     }
 }
 
+void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount)
+{
+    nSizeWithAncestors += modifySize;
+    assert(int64_t(nSizeWithAncestors) > 0);
+    nFeesWithAncestors += modifyFee;
+    assert(nFeesWithAncestors >= 0);
+    nCountWithAncestors += modifyCount;
+    assert(int64_t(nCountWithAncestors) > 0);
+}
+
+CTxMemPool::EpochGuard::EpochGuard(const CTxMemPool& in) : pool(in)
+{
+    assert(!pool.fHasEpochGuard);
+    ++pool.nEpoch;
+    pool.fHasEpochGuard = true;
+}
+
+CTxMemPool::EpochGuard::~EpochGuard()
+{
+    // Bump again, so that entries marked during this epoch are unvisited
+    // for the next guard.
+    ++pool.nEpoch;
+    pool.fHasEpochGuard = false;
+}
+
 CTxMemPool::CTxMemPool(const CFeeRate& _minReasonableRelayFee) :
-        nTransactionsUpdated(0)
+        nTransactionsUpdated(0),
+        fLoaded(false),
+        nLoadTotal(0),
+        nLoadProcessed(0),
+        nEpoch(0),
+        fHasEpochGuard(false)
 {
     _clear();   // lock-free clear
 
@@ -342,6 +433,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
     LOCK(cs);
 
     indexed_transaction_set::iterator newit = mapTx.insert(entry).first;
+    newit->nEpochMarker = 0;
     mapLinks.insert(make_pair(newit, TxLinks()));
 
     // Update cachedInnerUsage to include contained transaction's usage.
@@ -372,6 +464,7 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry &entry,
         }
     }
     UpdateAncestorsOf(true, newit, setAncestors);
+    UpdateEntryForAncestors(newit, setAncestors);
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
@@ -403,22 +496,23 @@ void CTxMemPool::removeUnchecked(txiter it)
 // can save time by not iterating over those entries.
 void CTxMemPool::CalculateDescendants(txiter entryit, setEntries &setDescendants)
 {
-    setEntries stage;
-    if (setDescendants.count(entryit) == 0) {
-        stage.insert(entryit);
+    std::vector<txiter> vStage;
+    EpochGuard epoch(*this);
+    if (!visited(entryit) && setDescendants.count(entryit) == 0) {
+        vStage.push_back(entryit);
     }
     // Traverse down the children of entry, only adding children that are not
     // accounted for in setDescendants already (because those children have either
     // already been walked, or will be walked in this iteration).
-    while (!stage.empty()) {
-        txiter it = *stage.begin();
+    while (!vStage.empty()) {
+        txiter it = vStage.back();
+        vStage.pop_back();
         setDescendants.insert(it);
-        stage.erase(it);
 
         const setEntries &setChildren = GetMemPoolChildren(it);
         for (const txiter& childiter : setChildren) {
-            if (!setDescendants.count(childiter)) {
-                stage.insert(childiter);
+            if (!visited(childiter) && !setDescendants.count(childiter)) {
+                vStage.push_back(childiter);
             }
         }
     }
@@ -511,18 +605,37 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
 {
     LOCK(cs);
     std::vector<CTxMemPoolEntry> entries;
+    setEntries setBlockEntries;
     for (const CTransaction& tx : vtx) {
         uint256 hash = tx.GetHash();
         indexed_transaction_set::iterator i = mapTx.find(hash);
-        if (i != mapTx.end())
+        if (i != mapTx.end()) {
             entries.push_back(*i);
+            setBlockEntries.insert(i);
+        }
     }
+    // Remove all of the block's transactions in a single pass. Their in-mempool
+    // ancestors are in the block too, but their descendants may stay behind.
+    RemoveStaged(setBlockEntries, true);
+
+    // Then everything spending the same inputs, with descendants.
+    setEntries setConflicts;
     for (const CTransaction& tx : vtx) {
-        std::list<CTransaction> dummy;
-        remove(tx, dummy, false);
-        removeConflicts(tx, conflicts);
+        for (const CTxIn& txin : tx.vin) {
+            std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(txin.prevout);
+            if (it != mapNextTx.end() && *it->second.ptx != tx) {
+                txiter conflictit = mapTx.find(it->second.ptx->GetHash());
+                assert(conflictit != mapTx.end());
+                CalculateDescendants(conflictit, setConflicts);
+            }
+        }
         ClearPrioritisation(tx.GetHash());
     }
+    for (const txiter& it : setConflicts) {
+        conflicts.push_back(it->GetTx());
+    }
+    RemoveStaged(setConflicts);
+
     // After the txs in the new block have been removed from the mempool, update policy estimates
     minerPolicyEstimator->processBlock(nBlockHeight, entries, fCurrentEstimate);
     lastRollingFeeUpdate = GetTime();
@@ -604,6 +717,21 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
             i++;
         }
         assert(setParentCheck == GetMemPoolParents(it));
+        // Verify ancestor state is correct.
+        setEntries setAncestors;
+        uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
+        std::string dummy;
+        CalculateMemPoolAncestors(*it, setAncestors, nNoLimit, nNoLimit, nNoLimit, nNoLimit, dummy);
+        uint64_t nCountCheck = setAncestors.size() + 1;
+        uint64_t nSizeCheck = it->GetTxSize();
+        CAmount nFeesCheck = it->GetFee();
+        for (const txiter& ancestorIt : setAncestors) {
+            nSizeCheck += ancestorIt->GetTxSize();
+            nFeesCheck += ancestorIt->GetFee();
+        }
+        assert(it->GetCountWithAncestors() == nCountCheck);
+        assert(it->GetSizeWithAncestors() == nSizeCheck);
+        assert(it->GetFeesWithAncestors() == nFeesCheck);
         // Check children against mapNextTx
         if (!fHasZerocoinSpends) {
             CTxMemPool::setEntries setChildrenCheck;
@@ -702,14 +830,40 @@ bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
 
 CFeeRate CTxMemPool::estimateFee(int nBlocks) const
 {
-    LOCK(cs);
     return minerPolicyEstimator->estimateFee(nBlocks);
 }
+CFeeRate CTxMemPool::estimateSmartFee(int nBlocks, int *answerFoundAtBlocks) const
+{
+    CFeeRate feeRate = minerPolicyEstimator->estimateSmartFee(nBlocks, answerFoundAtBlocks);
+    // A full mempool evicts anything below its minimum fee, so never
+    // suggest less than that once there is an estimate at all.
+    if (feeRate == CFeeRate(0))
+        return feeRate;
+    CFeeRate minPoolFee = GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+    if (minPoolFee > feeRate)
+        return minPoolFee;
+    return feeRate;
+}
 double CTxMemPool::estimatePriority(int nBlocks) const
 {
-    LOCK(cs);
     return minerPolicyEstimator->estimatePriority(nBlocks);
 }
+double CTxMemPool::estimateSmartPriority(int nBlocks, int *answerFoundAtBlocks) const
+{
+    // A full mempool does not relay free transactions at all, so a priority
+    // estimate is meaningless until it drains again.
+    if (GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000) > CFeeRate(0)) {
+        if (answerFoundAtBlocks)
+            *answerFoundAtBlocks = nBlocks;
+        return INF_PRIORITY;
+    }
+    return minerPolicyEstimator->estimateSmartPriority(nBlocks, answerFoundAtBlocks);
+}
+
+void CTxMemPool::ThreadFeeEstimator()
+{
+    minerPolicyEstimator->ThreadProcessEvents();
+}
 
 bool CTxMemPool::WriteFeeEstimates(CAutoFile& fileout) const
 {
@@ -808,10 +962,10 @@ size_t CTxMemPool::DynamicMemoryUsage() const
     return memusage::MallocUsage(sizeof(CTxMemPoolEntry) + 9 * sizeof(void*)) * mapTx.size() + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + memusage::DynamicUsage(mapLinks) + cachedInnerUsage;
 }
 
-void CTxMemPool::RemoveStaged(setEntries &stage)
+void CTxMemPool::RemoveStaged(setEntries &stage, bool updateDescendants)
 {
     AssertLockHeld(cs);
-    UpdateForRemoveFromMempool(stage);
+    UpdateForRemoveFromMempool(stage, updateDescendants);
     for (const txiter& it : stage) {
         removeUnchecked(it);
     }
@@ -7,6 +7,7 @@
 #ifndef BITCOIN_TXMEMPOOL_H
 #define BITCOIN_TXMEMPOOL_H
 
+#include <atomic>
 #include <list>
 #include <set>
 
@@ -54,6 +55,11 @@ class CTxMemPool;
  * nTxFee. (This can potentially happen during a reorg, where we limit the
  * amount of work we're willing to do to avoid consuming too much CPU.)
  *
+ * The mirror image, the ancestor state (nCountWithAncestors,
+ * nSizeWithAncestors and nFeesWithAncestors), is set when the entry is added
+ * and kept up to date as ancestors leave the mempool or come back during a
+ * reorg. It is never dirty.
+ *
  */
 class CTxMemPoolEntry
 {
@@ -80,6 +86,15 @@ private:
     uint64_t nSizeWithDescendants;  //! ... and size
     CAmount nFeesWithDescendants;  //! ... and total fees (all including us)
 
+    // Analogous statistics for ancestor transactions
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    CAmount nFeesWithAncestors;
+
+    //! Traversal marker, see CTxMemPool::visited()
+    mutable uint64_t nEpochMarker;
+    friend class CTxMemPool;
+
 public:
   CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
           int64_t _nTime, double _entryPriority, unsigned int _entryHeight,
@@ -102,6 +117,8 @@ public:
 
     // Adjusts the descendant state, if this entry is not dirty.
     void UpdateState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
+    // Adjusts the ancestor state
+    void UpdateAncestorState(int64_t modifySize, CAmount modifyFee, int64_t modifyCount);
 
     /** We can set the entry to be dirty if doing the full calculation of in-
      *  mempool descendants will be too expensive, which can potentially happen
@@ -113,6 +130,10 @@ public:
     uint64_t GetCountWithDescendants() const { return nCountWithDescendants; }
     uint64_t GetSizeWithDescendants() const { return nSizeWithDescendants; }
     CAmount GetFeesWithDescendants() const { return nFeesWithDescendants; }
+
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    CAmount GetFeesWithAncestors() const { return nFeesWithAncestors; }
 };
 
 // Helpers for modifying CTxMemPool::mapTx, which is a boost multi_index.
@@ -131,6 +152,21 @@ struct update_descendant_state
         int64_t modifyCount;
 };
 
+struct update_ancestor_state
+{
+    update_ancestor_state(int64_t _modifySize, CAmount _modifyFee, int64_t _modifyCount) :
+        modifySize(_modifySize), modifyFee(_modifyFee), modifyCount(_modifyCount)
+    {}
+
+    void operator() (CTxMemPoolEntry &e)
+        { e.UpdateAncestorState(modifySize, modifyFee, modifyCount); }
+
+    private:
+        int64_t modifySize;
+        CAmount modifyFee;
+        int64_t modifyCount;
+};
+
 struct set_dirty
 {
     void operator() (CTxMemPoolEntry &e)
@@ -261,7 +297,16 @@ public:
  * transaction along with its descendants, we must calculate that set of
  * transactions to be removed before doing the removal, or else the mempool can
  * be in an inconsistent state where it's impossible to walk the ancestors of
- * a transaction.)
+ * a transaction.)  The whole set is handled in one pass: the changes are
+ * summed per surviving relative, so that each of them is re-sorted in mapTx
+ * only once, however many of its ancestors or descendants leave the pool.
+ * Transactions confirmed by a block are removed that way as well, in which
+ * case their remaining in-mempool descendants get their ancestor state
+ * reduced instead.
+ *
+ * Walks over the transaction graph mark the entries they reach with the
+ * current traversal epoch (see EpochGuard and visited()) instead of
+ * collecting them in a temporary std::set.
  *
  * In the event of a reorg, the assumption that a newly added tx has no
  * in-mempool children is false.  In particular, the mempool is in an
@@ -312,6 +357,13 @@ private:
     mutable bool blockSinceLastRollingFeeBump;
     mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
 
+    std::atomic<bool> fLoaded;            //! whether the persisted mempool has been (re)loaded
+    std::atomic<uint64_t> nLoadTotal;     //! transactions found in mempool.dat at startup
+    std::atomic<uint64_t> nLoadProcessed; //! ... and those processed so far
+
+    mutable uint64_t nEpoch;              //! current graph traversal epoch, see visited()
+    mutable bool fHasEpochGuard;          //! whether an EpochGuard is active
+
     void trackPackageRemoved(const CFeeRate& rate);
 
 public:
@@ -389,7 +441,37 @@ private:
     void UpdateParent(txiter entry, txiter parent, bool add);
     void UpdateChild(txiter entry, txiter child, bool add);
 
+    /** Size, fee and count changes summed up for one entry */
+    struct StateDelta {
+        int64_t nSize;
+        CAmount nFee;
+        int64_t nCount;
+        StateDelta() : nSize(0), nFee(0), nCount(0) {}
+    };
+    typedef std::map<txiter, StateDelta, CompareIteratorByHash> deltaMap;
+
 public:
+    /** Starts a new traversal epoch for the lifetime of the guard. Entries
+     *  reached before the guard was created count as unvisited. Guards
+     *  cannot be nested. */
+    class EpochGuard
+    {
+        const CTxMemPool& pool;
+    public:
+        EpochGuard(const CTxMemPool& in);
+        ~EpochGuard();
+    };
+
+    /** Mark an entry as visited in the current epoch, returning whether it
+     *  already was. Requires an active EpochGuard. */
+    bool visited(txiter it) const
+    {
+        assert(fHasEpochGuard);
+        bool ret = it->nEpochMarker >= nEpoch;
+        it->nEpochMarker = std::max(it->nEpochMarker, nEpoch);
+        return ret;
+    }
+
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
@@ -440,8 +522,10 @@ public:
 
     /** Remove a set of transactions from the mempool.
      *  If a transaction is in this set, then all in-mempool descendants must
-     *  also be in the set.*/
-    void RemoveStaged(setEntries &stage);
+     *  also be in the set, unless updateDescendants is true (as when the
+     *  transactions were confirmed by a block), in which case the ancestor
+     *  state of the descendants left behind is updated. */
+    void RemoveStaged(setEntries &stage, bool updateDescendants = false);
 
     /** When adding transactions from a disconnected block back to the mempool,
      *  new mempool entries may have children in the mempool (which is generally
@@ -462,7 +546,7 @@ public:
      *  limitDescendantSize = max size of descendants any ancestor can have
      *  errString = populated with error reason if any limits are hit
      */
-    bool CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString);
+    bool CalculateMemPoolAncestors(const CTxMemPoolEntry &entry, setEntries &setAncestors, uint64_t limitAncestorCount, uint64_t limitAncestorSize, uint64_t limitDescendantCount, uint64_t limitDescendantSize, std::string &errString) const;
 
     /** The minimum fee to get into the mempool, which may itself not be enough
      *  for larger-sized transactions.
@@ -500,15 +584,46 @@ public:
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
+    /** Estimate fee rate needed to get into the next nBlocks
+     *  If no answer can be given at nBlocks, return an estimate
+     *  at the lowest number of blocks where one can be given
+     */
+    CFeeRate estimateSmartFee(int nBlocks, int *answerFoundAtBlocks = NULL) const;
+
     /** Estimate priority needed to get into the next nBlocks */
     double estimatePriority(int nBlocks) const;
 
+    /** Estimate priority needed to get into the next nBlocks
+     *  If no answer can be given at nBlocks, return an estimate
+     *  at the lowest number of blocks where one can be given
+     */
+    double estimateSmartPriority(int nBlocks, int *answerFoundAtBlocks = NULL) const;
+
+    /** Apply queued fee estimator events in the background until interrupted */
+    void ThreadFeeEstimator();
+
     /** Write/Read estimates to disk */
     bool WriteFeeEstimates(CAutoFile& fileout) const;
     bool ReadFeeEstimates(CAutoFile& filein);
 
     size_t DynamicMemoryUsage() const;
 
+    /** Whether loading of the persisted mempool has finished (or was skipped) */
+    bool IsLoaded() const { return fLoaded; }
+    void SetIsLoaded(bool loaded) { fLoaded = loaded; }
+
+    /** Progress of the background reload of mempool.dat, see LoadMempool() */
+    void SetLoadProgress(uint64_t nProcessed, uint64_t nTotal)
+    {
+        nLoadProcessed = nProcessed;
+        nLoadTotal = nTotal;
+    }
+    double GetLoadProgress() const
+    {
+        uint64_t nTotal = nLoadTotal;
+        return nTotal == 0 ? (fLoaded ? 1.0 : 0.0) : (double)nLoadProcessed / nTotal;
+    }
+
 private:
     /** UpdateForDescendants is used by UpdateTransactionsFromBlock to update
      *  the descendants for a single transaction that has been added to the
@@ -532,8 +647,15 @@ private:
             const std::set<uint256> &setExclude);
     /** Update ancestors of hash to add/remove it as a descendant transaction. */
     void UpdateAncestorsOf(bool add, txiter hash, setEntries &setAncestors);
-    /** For each transaction being removed, update ancestors and any direct children. */
-    void UpdateForRemoveFromMempool(const setEntries &entriesToRemove);
+    /** Set the ancestor state of a newly added entry from its ancestors. */
+    void UpdateEntryForAncestors(txiter it, const setEntries &setAncestors);
+    /** For each transaction being removed, update ancestors and any direct children.
+     *  If updateDescendants is set, the ancestor state of in-mempool descendants
+     *  that are not being removed is updated too. */
+    void UpdateForRemoveFromMempool(const setEntries &entriesToRemove, bool updateDescendants);
+    /** Add the size/fee/count of each entry in entries to the delta of each of
+     *  its ancestors (or descendants) that is not in entriesToSkip. */
+    void SumRelativeDeltas(const setEntries &entries, bool fAncestors, const setEntries &entriesToSkip, deltaMap &mapDeltas);
     /** Sever link between specified transaction and direct children. */
     void UpdateChildrenForRemoval(txiter entry);
     /** Populate setDescendants with all in-mempool descendants of hash.
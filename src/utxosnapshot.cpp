@@ -0,0 +1,498 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "guiinterface.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "validationinterface.h"
+
+#include <stdio.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Block index records are written in this format whatever the client version,
+ * so that the checksum of a snapshot only depends on the chain it holds.
+ */
+static const int SNAPSHOT_SER_VERSION = DBI_SER_VERSION_HASH;
+
+/** stdio buffer of snapshot files, they are only ever read and written sequentially */
+static const size_t SNAPSHOT_FILE_BUFFER = 1 << 20;
+
+/** Passes everything read from or written to a snapshot file through SHA256d */
+class CHashingFile
+{
+private:
+    CAutoFile& file;
+    CHash256 hasher;
+
+public:
+    CHashingFile(CAutoFile& fileIn) : file(fileIn) {}
+
+    int GetType() const { return SER_DISK; }
+    int GetVersion() const { return SNAPSHOT_SER_VERSION; }
+
+    void read(char* pch, size_t nSize)
+    {
+        file.read(pch, nSize);
+        hasher.Write((const unsigned char*)pch, nSize);
+    }
+
+    void ignore(size_t nSize)
+    {
+        char data[4096];
+        while (nSize > 0) {
+            size_t nNow = std::min<size_t>(nSize, sizeof(data));
+            read(data, nNow);
+            nSize -= nNow;
+        }
+    }
+
+    void write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        hasher.Write((const unsigned char*)pch, nSize);
+    }
+
+    template <typename T>
+    CHashingFile& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj);
+        return (*this);
+    }
+
+    template <typename T>
+    CHashingFile& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj);
+        return (*this);
+    }
+
+    // invalidates the object
+    uint256 GetHash()
+    {
+        uint256 result;
+        hasher.Finalize(result.begin());
+        return result;
+    }
+};
+
+/** Records of the coins and zerocoin sections are preceded by a marker, the end of a section by a zero */
+static const uint8_t SNAPSHOT_RECORD = 1;
+static const uint8_t SNAPSHOT_END = 0;
+
+static void ApplyCoinsToStats(CCoinStatsEntry& stats, const uint256& txid, const CCoins& coins)
+{
+    stats.nTransactions++;
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        const CTxOut& out = coins.vout[i];
+        if (out.IsNull())
+            continue;
+        ApplyCoinToMuHash(stats.muhash, COutPoint(txid, i), out, false);
+        stats.nTransactionOutputs++;
+        stats.nBogoSize += GetBogoSize(out.scriptPubKey);
+        stats.nTotalAmount += out.nValue;
+    }
+}
+
+bool WriteUTXOSnapshot(CAutoFile& fileout, const std::vector<const CBlockIndex*>& vChain, CCoinsViewDBCursor& coinsCursor, CDBIterator& zerocoinCursor, int64_t nMoneySupply, CUTXOSnapshotInfo& info)
+{
+    if (vChain.empty())
+        return error("%s : empty chain", __func__);
+
+    CHashingFile file(fileout);
+    info = CUTXOSnapshotInfo();
+    info.metadata.hashBaseBlock = vChain.back()->GetBlockHash();
+    info.metadata.nBaseHeight = vChain.back()->nHeight;
+    memcpy(info.metadata.pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE);
+    info.stats.nHeight = info.metadata.nBaseHeight;
+    info.nMoneySupply = nMoneySupply;
+
+    try {
+        file << info.metadata;
+
+        // Only what every node has for these blocks, so that the records and
+        // hence the checksum do not depend on where the snapshot was taken
+        for (const CBlockIndex* pindex : vChain) {
+            CDiskBlockIndex diskindex(pindex);
+            diskindex.nStatus = pindex->nStatus & BLOCK_VALID_MASK;
+            diskindex.nFile = 0;
+            diskindex.nDataPos = 0;
+            diskindex.nUndoPos = 0;
+            file << diskindex;
+        }
+
+        for (; coinsCursor.Valid(); coinsCursor.Next()) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            if (!coinsCursor.GetKey(txid) || !coinsCursor.GetValue(coins))
+                return error("%s : unable to read coins", __func__);
+            file << SNAPSHOT_RECORD << txid << coins;
+            ApplyCoinsToStats(info.stats, txid, coins);
+        }
+        file << SNAPSHOT_END;
+
+        std::vector<char> vchKey, vchValue;
+        for (zerocoinCursor.SeekToFirst(); zerocoinCursor.Valid(); zerocoinCursor.Next()) {
+            boost::this_thread::interruption_point();
+            zerocoinCursor.GetKeyBytes(vchKey);
+            zerocoinCursor.GetValueBytes(vchValue);
+            file << SNAPSHOT_RECORD << vchKey << vchValue;
+            info.nZerocoinRecords++;
+        }
+        file << SNAPSHOT_END;
+
+        info.stats.muhash.Finalize(info.stats.hashMuHash);
+        file << info.stats.nTransactions << info.nZerocoinRecords << info.nMoneySupply << info.stats.hashMuHash;
+
+        info.hashSnapshot = file.GetHash();
+        fileout << info.hashSnapshot;
+    } catch (const std::exception& e) {
+        return error("%s : Serialize or I/O error - %s", __func__, e.what());
+    }
+    return true;
+}
+
+/** Check the block index record of the given height against the hash of its parent, which it replaces with its own */
+static bool CheckSnapshotIndexRecord(const CDiskBlockIndex& diskindex, int nHeight, uint256& hashPrev, std::string& strError)
+{
+    const uint256 hash = diskindex.ComputeBlockHash();
+    if (diskindex.nHeight != nHeight || diskindex.hashPrev != hashPrev || (diskindex.HasStoredHash() && diskindex.hashBlock != hash)) {
+        strError = strprintf("bad block index record at height %d", nHeight);
+        return false;
+    }
+    hashPrev = hash;
+    return true;
+}
+
+bool VerifyUTXOSnapshot(CAutoFile& filein, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    CHashingFile file(filein);
+    info = CUTXOSnapshotInfo();
+
+    try {
+        CSnapshotMetadata& metadata = info.metadata;
+        file >> metadata;
+        if (metadata.nMagic != CSnapshotMetadata::SNAPSHOT_MAGIC || metadata.nVersion != CSnapshotMetadata::SNAPSHOT_VERSION) {
+            strError = "not a UTXO snapshot, or of an unsupported version";
+            return false;
+        }
+        if (memcmp(metadata.pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0) {
+            strError = "the snapshot was taken on another network";
+            return false;
+        }
+        if (metadata.nBaseHeight < 0) {
+            strError = "bad base height";
+            return false;
+        }
+        info.stats.nHeight = metadata.nBaseHeight;
+
+        // The base block hash commits to the whole chain of records
+        uint256 hashPrev;
+        for (int nHeight = 0; nHeight <= metadata.nBaseHeight; nHeight++) {
+            CDiskBlockIndex diskindex;
+            file >> diskindex;
+            if (!CheckSnapshotIndexRecord(diskindex, nHeight, hashPrev, strError))
+                return false;
+            if (nHeight == 0 && hashPrev != Params().GetConsensus().hashGenesisBlock) {
+                strError = "the snapshot starts from another genesis block";
+                return false;
+            }
+        }
+        if (hashPrev != metadata.hashBaseBlock) {
+            strError = "the block index records do not lead to the base block";
+            return false;
+        }
+
+        // Coins are dumped in database (byte) order, so strictly increasing txids rule out duplicates
+        uint256 txidPrev;
+        uint8_t nMarker;
+        for (file >> nMarker; nMarker == SNAPSHOT_RECORD; file >> nMarker) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            CCoins coins;
+            file >> txid >> coins;
+            if ((info.stats.nTransactions > 0 && memcmp(txidPrev.begin(), txid.begin(), txid.size()) >= 0) || coins.IsPruned()) {
+                strError = strprintf("bad coins record %s", txid.GetHex());
+                return false;
+            }
+            ApplyCoinsToStats(info.stats, txid, coins);
+            txidPrev = txid;
+        }
+        if (nMarker != SNAPSHOT_END) {
+            strError = "bad coins section";
+            return false;
+        }
+
+        std::vector<char> vchKey, vchValue;
+        for (file >> nMarker; nMarker == SNAPSHOT_RECORD; file >> nMarker) {
+            file >> vchKey >> vchValue;
+            info.nZerocoinRecords++;
+        }
+        if (nMarker != SNAPSHOT_END) {
+            strError = "bad zerocoin section";
+            return false;
+        }
+
+        uint64_t nTransactions, nZerocoinRecords;
+        uint256 hashMuHash;
+        file >> nTransactions >> nZerocoinRecords >> info.nMoneySupply >> hashMuHash;
+        info.stats.muhash.Finalize(info.stats.hashMuHash);
+        if (nTransactions != info.stats.nTransactions || nZerocoinRecords != info.nZerocoinRecords || hashMuHash != info.stats.hashMuHash) {
+            strError = "the coins do not match the snapshot trailer";
+            return false;
+        }
+
+        uint256 hashSnapshot;
+        info.hashSnapshot = file.GetHash();
+        filein >> hashSnapshot;
+        if (hashSnapshot != info.hashSnapshot) {
+            strError = "checksum mismatch";
+            return false;
+        }
+        if (fgetc(filein.Get()) != EOF) {
+            strError = "trailing data after the checksum";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("deserialize or I/O error - %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(CAutoFile& filein, const CUTXOSnapshotInfo& info, CCoinsViewDB& coinsdb, CZerocoinDB& zerocoindb, std::vector<CBlockIndex*>& vChain, std::string& strError)
+{
+    CHashingFile file(filein);
+
+    try {
+        CSnapshotMetadata metadata;
+        file >> metadata;
+        if (metadata.hashBaseBlock != info.metadata.hashBaseBlock || metadata.nBaseHeight != info.metadata.nBaseHeight) {
+            strError = "the snapshot changed since it was verified";
+            return false;
+        }
+
+        // Entries carry the validity of the snapshot, not the block data
+        uint256 hashPrev;
+        vChain.clear();
+        vChain.reserve(metadata.nBaseHeight + 1);
+        for (int nHeight = 0; nHeight <= metadata.nBaseHeight; nHeight++) {
+            CDiskBlockIndex diskindex;
+            file >> diskindex;
+            if (!CheckSnapshotIndexRecord(diskindex, nHeight, hashPrev, strError))
+                return false;
+
+            CBlockIndex* pindexNew = InsertBlockIndex(hashPrev);
+            if (nHeight > 0) {
+                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
+                pindexNew->nHeight = diskindex.nHeight;
+                pindexNew->nVersion = diskindex.nVersion;
+                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+                pindexNew->nTime = diskindex.nTime;
+                pindexNew->nBits = diskindex.nBits;
+                pindexNew->nNonce = diskindex.nNonce;
+                pindexNew->nStatus = (diskindex.nStatus & BLOCK_VALID_MASK) | BLOCK_ASSUMED_VALID;
+                pindexNew->nTx = diskindex.nTx;
+                pindexNew->SetAccumulatorCheckpoint(diskindex.GetAccumulatorCheckpoint());
+                pindexNew->nFlags = diskindex.nFlags;
+                pindexNew->stakeModifier = diskindex.stakeModifier;
+                pindexNew->nStakeModifierSize = diskindex.nStakeModifierSize;
+            }
+            vChain.push_back(pindexNew);
+        }
+
+        CCoinsMap mapCoins;
+        uint8_t nMarker;
+        for (file >> nMarker; nMarker == SNAPSHOT_RECORD; file >> nMarker) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            file >> txid;
+            CCoinsCacheEntry& entry = mapCoins[txid];
+            file >> entry.coins;
+            entry.flags = CCoinsCacheEntry::DIRTY;
+            // BatchWrite empties the map, the best block is only set once the chain is activated
+            if (mapCoins.size() == SNAPSHOT_LOAD_BATCH && !coinsdb.BatchWrite(mapCoins, UINT256_ZERO)) {
+                strError = "failed to write coins";
+                return false;
+            }
+        }
+        if (!mapCoins.empty() && !coinsdb.BatchWrite(mapCoins, UINT256_ZERO)) {
+            strError = "failed to write coins";
+            return false;
+        }
+
+        CDBBatch batch;
+        size_t nBatch = 0;
+        std::vector<char> vchKey, vchValue;
+        for (file >> nMarker; nMarker == SNAPSHOT_RECORD; file >> nMarker) {
+            file >> vchKey >> vchValue;
+            batch.WriteBytes(vchKey, vchValue);
+            if (++nBatch == SNAPSHOT_LOAD_BATCH) {
+                if (!zerocoindb.WriteBatch(batch)) {
+                    strError = "failed to write zerocoin records";
+                    return false;
+                }
+                batch.Clear();
+                nBatch = 0;
+            }
+        }
+        if (nBatch > 0 && !zerocoindb.WriteBatch(batch)) {
+            strError = "failed to write zerocoin records";
+            return false;
+        }
+
+        uint64_t nTransactions, nZerocoinRecords;
+        int64_t nMoneySupply;
+        uint256 hashMuHash;
+        file >> nTransactions >> nZerocoinRecords >> nMoneySupply >> hashMuHash;
+        if (file.GetHash() != info.hashSnapshot) {
+            strError = "the snapshot changed since it was verified";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("deserialize or I/O error - %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool DumpTxOutSet(const fs::path& path, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    if (fs::exists(path)) {
+        strError = path.string() + " already exists";
+        return false;
+    }
+
+    // Write to a temporary file first, so a failed dump never looks like a snapshot
+    fs::path pathTmp = path.string() + ".incomplete";
+    std::vector<char> vchBuffer(SNAPSHOT_FILE_BUFFER);
+    FILE* file = fsbridge::fopen(pathTmp, "wb");
+    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
+    if (fileout.IsNull()) {
+        strError = "unable to open " + pathTmp.string();
+        return false;
+    }
+    setvbuf(fileout.Get(), vchBuffer.data(), _IOFBF, vchBuffer.size());
+
+    // The database iterators read from implicit snapshots of the flushed
+    // state, so the lock is only needed until they are created.
+    std::vector<const CBlockIndex*> vChain;
+    boost::scoped_ptr<CCoinsViewDBCursor> pcoinsCursor;
+    boost::scoped_ptr<CDBIterator> pzerocoinCursor;
+    int64_t nSupply;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        vChain.reserve(chainActive.Height() + 1);
+        for (int nHeight = 0; nHeight <= chainActive.Height(); nHeight++)
+            vChain.push_back(chainActive[nHeight]);
+        pcoinsCursor.reset(pcoinsdbview->Cursor());
+        pzerocoinCursor.reset(zerocoinDB->NewIterator());
+        nSupply = nMoneySupply;
+    }
+
+    LogPrintf("Writing UTXO snapshot at height %d to %s\n", vChain.back()->nHeight, path.string());
+    if (!WriteUTXOSnapshot(fileout, vChain, *pcoinsCursor, *pzerocoinCursor, nSupply, info)) {
+        strError = "failed to write the snapshot, see debug.log";
+        return false;
+    }
+    FileCommit(fileout.Get());
+    fileout.fclose();
+
+    if (!RenameOver(pathTmp, path)) {
+        strError = "rename-into-place failed";
+        return false;
+    }
+
+    LogPrintf("Dumped UTXO snapshot: %u transactions, %u zerocoin records, checksum %s, %dms\n",
+              info.stats.nTransactions, info.nZerocoinRecords, info.hashSnapshot.GetHex(), GetTimeMillis() - nStart);
+    return true;
+}
+
+bool LoadTxOutSet(const fs::path& path, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    int64_t nStart = GetTimeMillis();
+
+    std::vector<char> vchBuffer(SNAPSHOT_FILE_BUFFER);
+    FILE* file = fsbridge::fopen(path, "rb");
+    CAutoFile filein(file, SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        strError = "unable to open " + path.string();
+        return false;
+    }
+    setvbuf(filein.Get(), vchBuffer.data(), _IOFBF, vchBuffer.size());
+
+    // First pass: check everything before touching the databases
+    LogPrintf("Verifying UTXO snapshot %s\n", path.string());
+    if (!VerifyUTXOSnapshot(filein, info, strError))
+        return false;
+
+    const MapAssumeutxo& mapAssumeutxo = Params().Assumeutxo();
+    MapAssumeutxo::const_iterator it = mapAssumeutxo.find(info.metadata.nBaseHeight);
+    if (it != mapAssumeutxo.end()) {
+        if (it->second.hashBlock != info.metadata.hashBaseBlock || it->second.hashSnapshot != info.hashSnapshot) {
+            strError = strprintf("the snapshot does not match the one trusted at height %d", info.metadata.nBaseHeight);
+            return false;
+        }
+    } else if (!Params().IsRegTestNet()) {
+        // Regression test chains are different every time, there is nothing to commit to
+        strError = strprintf("no snapshot at height %d is trusted by this release", info.metadata.nBaseHeight);
+        return false;
+    }
+
+    CBlockIndex* pindexBase;
+    {
+        LOCK(cs_main);
+        if (fImporting || fReindex || chainActive.Height() != 0 || mapBlockIndex.size() != 1) {
+            strError = "a snapshot can only be loaded by a node without blocks besides the genesis block (start it with -connect=0)";
+            return false;
+        }
+        if (fBlockFilterIndex) {
+            strError = "the compact block filter index cannot be built on top of a snapshot";
+            return false;
+        }
+
+        // Second pass: bulk-load the databases, with the coins cache empty
+        FlushStateToDisk();
+        if (!pblocktree->WriteFlag("snapshotloading", true) || !pblocktree->Sync()) {
+            strError = "failed to write to the block index database";
+            return false;
+        }
+        rewind(filein.Get());
+        LogPrintf("Loading UTXO snapshot at height %d: %u transactions, %u zerocoin records\n",
+                  info.metadata.nBaseHeight, info.stats.nTransactions, info.nZerocoinRecords);
+
+        std::vector<CBlockIndex*> vChain;
+        pcoinsdbview->SetBulkLoad(true);
+        bool fLoaded = LoadUTXOSnapshot(filein, info, *pcoinsdbview, *zerocoinDB, vChain, strError);
+        pcoinsdbview->SetBulkLoad(false);
+        if (!fLoaded || !ActivateSnapshotChain(vChain, info, strError)) {
+            strError += ", restart with -reindex to start over";
+            return false;
+        }
+        pblocktree->WriteFlag("snapshotloading", false);
+        pindexBase = vChain.back();
+    }
+    pcoinsdbview->Compact();
+
+    uiInterface.NotifyBlockTip(IsInitialBlockDownload(), pindexBase);
+    GetMainSignals().UpdatedBlockTip(pindexBase);
+
+    LogPrintf("Loaded UTXO snapshot: tip %s at height %d, %dms\n",
+              pindexBase->GetBlockHash().GetHex(), pindexBase->nHeight, GetTimeMillis() - nStart);
+    return true;
+}
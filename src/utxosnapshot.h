@@ -0,0 +1,110 @@
+// Copyright (c) 2020 The TARIAN developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TARIAN_UTXOSNAPSHOT_H
+#define TARIAN_UTXOSNAPSHOT_H
+
+#include "coinstats.h"
+#include "fs.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class CAutoFile;
+class CBlockIndex;
+class CCoinsViewDB;
+class CCoinsViewDBCursor;
+class CDBIterator;
+class CZerocoinDB;
+
+/** Coins or zerocoin records written to the databases at once while loading a snapshot */
+static const size_t SNAPSHOT_LOAD_BATCH = 100000;
+
+/**
+ * Header of a UTXO snapshot, as written by dumptxoutset. It is followed by
+ *  - the block index records of the chain from the genesis block to the base block,
+ *  - the unspent transactions of the chainstate as of the base block,
+ *  - the raw records of the zerocoin database,
+ *  - a trailer with the record counts, the MuHash of the coins and the money supply,
+ *  - the SHA256d of everything before it.
+ */
+class CSnapshotMetadata
+{
+public:
+    static const uint32_t SNAPSHOT_MAGIC = 0x7478746f; // "otxt"
+    static const uint32_t SNAPSHOT_VERSION = 1;
+
+    uint32_t nMagic;
+    uint32_t nVersion;
+    unsigned char pchMessageStart[MESSAGE_START_SIZE];
+    uint256 hashBaseBlock;
+    int nBaseHeight;
+
+    CSnapshotMetadata() : nMagic(SNAPSHOT_MAGIC), nVersion(SNAPSHOT_VERSION), nBaseHeight(-1)
+    {
+        memset(pchMessageStart, 0, MESSAGE_START_SIZE);
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action)
+    {
+        READWRITE(nMagic);
+        READWRITE(nVersion);
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBaseBlock);
+        READWRITE(nBaseHeight);
+    }
+};
+
+/** What a snapshot holds, as established by writing or verifying it */
+class CUTXOSnapshotInfo
+{
+public:
+    CSnapshotMetadata metadata;
+    //! Statistics of the coins, as the coin stats index keeps them for the base block
+    CCoinStatsEntry stats;
+    uint64_t nZerocoinRecords;
+    int64_t nMoneySupply;
+    //! Checksum of the whole file, what chainparams commits to
+    uint256 hashSnapshot;
+
+    CUTXOSnapshotInfo() : nZerocoinRecords(0), nMoneySupply(0) {}
+};
+
+/**
+ * Write a snapshot of the given chain (genesis first) and databases. The
+ * cursors must have been created while the databases were flushed up to the
+ * last block of vChain, so that their implicit snapshots match it.
+ */
+bool WriteUTXOSnapshot(CAutoFile& fileout, const std::vector<const CBlockIndex*>& vChain, CCoinsViewDBCursor& coinsCursor, CDBIterator& zerocoinCursor, int64_t nMoneySupply, CUTXOSnapshotInfo& info);
+
+/**
+ * Read a whole snapshot without storing anything: checks the network, the
+ * hash chain of the block index records, the order and statistics of the
+ * coins and the checksum.
+ */
+bool VerifyUTXOSnapshot(CAutoFile& filein, CUTXOSnapshotInfo& info, std::string& strError);
+
+/**
+ * Read a verified snapshot again, adding its block index records to
+ * mapBlockIndex (vChain receives them, genesis first) and bulk-loading its
+ * coins and zerocoin records into the given databases. The checksum is
+ * checked once more against the one of the verification pass.
+ */
+bool LoadUTXOSnapshot(CAutoFile& filein, const CUTXOSnapshotInfo& info, CCoinsViewDB& coinsdb, CZerocoinDB& zerocoindb, std::vector<CBlockIndex*>& vChain, std::string& strError);
+
+/** Flush the chainstate and dump it to a new snapshot file (dumptxoutset) */
+bool DumpTxOutSet(const fs::path& path, CUTXOSnapshotInfo& info, std::string& strError);
+
+/** Verify a snapshot against chainparams and make it the chainstate of a fresh node (loadtxoutset) */
+bool LoadTxOutSet(const fs::path& path, CUTXOSnapshotInfo& info, std::string& strError);
+
+#endif // TARIAN_UTXOSNAPSHOT_H
@@ -7,6 +7,7 @@
 
 #include <map>
 #include <list>
+#include <set>
 
 #include "ztarn/zerocoin.h"
 #include "libzerocoin/bignum.h"
@@ -25,6 +26,8 @@ class CMintPool : public std::map<uint256, uint32_t> //pubcoin hash, count
 private:
     uint32_t nCountLastGenerated;
     uint32_t nCountLastRemoved;
+    //! counts of the mints in the pool, so that the counts already derived are found without a scan
+    std::set<uint32_t> setCounts;
 
 public:
     CMintPool();
@@ -32,6 +35,7 @@ public:
     void Add(const CBigNum& bnValue, const uint32_t& nCount);
     void Add(const std::pair<uint256, uint32_t>& pMint, bool fVerbose = false);
     bool Has(const CBigNum& bnValue);
+    bool HasCount(uint32_t nCount) const { return setCounts.count(nCount) > 0; }
     void Remove(const CBigNum& bnValue);
     void Remove(const uint256& hashPubcoin);
     std::pair<uint256, uint32_t> Get(const CBigNum& bnValue);
@@ -11,6 +11,10 @@
 #include "deterministicmint.h"
 #include "ztarnchain.h"
 
+#include <atomic>
+
+#include <boost/thread.hpp>
+
 
 CzTARNWallet::CzTARNWallet(CWallet* parent)
 {
@@ -120,37 +124,46 @@ void CzTARNWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
-
     uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
     LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
-    for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
 
-        fFound = false;
+    // Prevent unnecessary repeated minted
+    std::vector<uint32_t> vCounts;
+    for (uint32_t i = n; i < nStop; ++i) {
+        if (!mintPool.HasCount(i))
+            vCounts.push_back(i);
+    }
+    if (vCounts.empty())
+        return;
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
+    // Each mint takes modular exponentiations and a search for a prime, but
+    // depends on nothing but the seed and its count: derive them on several threads
+    std::vector<CBigNum> vValues(vCounts.size());
+    std::atomic<size_t> nNext(0);
+    auto derive = [&]() {
+        size_t i;
+        while ((i = nNext++) < vCounts.size() && !ShutdownRequested()) {
+            CBigNum bnSerial;
+            CBigNum bnRandomness;
+            CKey key;
+            SeedToZTARN(GetZerocoinSeed(vCounts[i]), vValues[i], bnSerial, bnRandomness, key);
         }
+    };
+    const int nThreads = std::min((int)vCounts.size(), std::max(1, std::min(GetNumCores(), MAX_MINTPOOL_THREADS)));
+    boost::thread_group threadGroup;
+    for (int i = 1; i < nThreads; i++)
+        threadGroup.create_thread(derive);
+    derive();
+    threadGroup.join_all();
+
+    if (ShutdownRequested())
+        return;
 
-        if(fFound)
-            continue;
-
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
-        CBigNum bnSerial;
-        CBigNum bnRandomness;
-        CKey key;
-        SeedToZTARN(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
-
-        mintPool.Add(bnValue, i);
-        CWalletDB(wallet->strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+    CWalletDB walletdb(wallet->strWalletFile);
+    for (size_t i = 0; i < vCounts.size(); i++) {
+        mintPool.Add(vValues[i], vCounts[i]);
+        walletdb.WriteMintPoolPair(hashSeed, GetPubCoinHash(vValues[i]), vCounts[i]);
+        LogPrintf("%s : %s count=%d\n", __func__, vValues[i].GetHex().substr(0, 6), vCounts[i]);
     }
 }
 
@@ -192,25 +205,31 @@ void CzTARNWallet::SyncWithChain(bool fGenerateMintPool)
             GenerateMintPool();
         LogPrintf("%s: Mintpool size=%d\n", __func__, mintPool.size());
 
-        std::set<uint256> setChecked;
+        // Look up the whole pool in the zerocoin database at once, leaving
+        // out the mints the tracker knows already
         std::list<std::pair<uint256,uint32_t> > listMints = mintPool.List();
-        for (std::pair<uint256, uint32_t> pMint : listMints) {
-            LOCK(cs_main);
-            if (setChecked.count(pMint.first))
-                return;
-            setChecked.insert(pMint.first);
+        std::vector<uint256> vHashPubcoin;
+        for (const std::pair<uint256, uint32_t>& pMint : listMints) {
+            if (wallet->ztarnTracker->HasPubcoinHash(pMint.first))
+                mintPool.Remove(pMint.first);
+            else
+                vHashPubcoin.push_back(pMint.first);
+        }
 
-            if (ShutdownRequested())
-                return;
+        if (ShutdownRequested())
+            return;
 
-            if (wallet->ztarnTracker->HasPubcoinHash(pMint.first)) {
-                mintPool.Remove(pMint.first);
-                continue;
-            }
+        LOCK(cs_main);
+        std::map<uint256, uint256> mapMintTx;
+        if (!zerocoinDB->ReadCoinMints(vHashPubcoin, mapMintTx)) {
+            LogPrintf("%s : failed to look up the mint pool in the zerocoin database\n", __func__);
+            return;
+        }
 
-            uint256 txHash;
-            CZerocoinMint mint;
-            if (zerocoinDB->ReadCoinMint(pMint.first, txHash)) {
+        for (const std::pair<uint256, uint32_t>& pMint : listMints) {
+            auto it = mapMintTx.find(pMint.first);
+            if (it != mapMintTx.end()) {
+                const uint256& txHash = it->second;
                 //this mint has already occurred on the chain, increment counter's state to reflect this
                 LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), pMint.second, txHash.GetHex());
                 found = true;
@@ -14,6 +14,9 @@
 
 class CDeterministicMint;
 
+/** Maximum number of threads deriving the mints of the mint pool */
+static const int MAX_MINTPOOL_THREADS = 8;
+
 class CzTARNWallet
 {
 private: